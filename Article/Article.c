@@ -0,0 +1,137 @@
+#include "Article.h"
+
+/**
+ * Creates an article holding a copy of the given text.
+ *
+ * @param text     The text of the article.
+ * @param priority The priority lane of the article (PRIORITY_HIGH or PRIORITY_NORMAL).
+ * @return a pointer to the new article.
+ */
+Article* newArticle(const char* text, int priority) {
+    return newArticleFromBytes(text, strlen(text), priority);
+}
+
+/**
+ * Creates an article holding a copy of the given bytes (which need not be null terminated).
+ *
+ * @param text     The text of the article.
+ * @param length   The length of the text.
+ * @param priority The priority lane of the article (PRIORITY_HIGH or PRIORITY_NORMAL).
+ * @return a pointer to the new article.
+ */
+Article* newArticleFromBytes(const char* text, size_t length, int priority) {
+    Article* article = malloc(sizeof(Article));
+    Payload* payload = malloc(sizeof(Payload) + length + 1);
+    payload->refs = 1;
+    article->text = payload->text;
+    memcpy(article->text, text, length);
+    article->text[length] = '\0';
+    article->priority = priority;
+    article->producer = -1;
+    article->seq = 0;
+    article->intendedNs = 0;
+    article->id = 0;
+    article->auditId = 0;
+    article->done = 0;
+    return article;
+}
+
+/**
+ * Creates the "DONE" message a stage sends when it has finished. It is marked out of band, so an
+ * article whose text happens to read "DONE" is not taken for it.
+ *
+ * @return a pointer to the new message.
+ */
+Article* newDone() {
+    Article* done = newArticle("DONE", PRIORITY_NORMAL);
+    done->done = 1;
+    return done;
+}
+
+/**
+ * Creates a copy of an article that shares its text. Each copy is owned separately, and the text is
+ * freed with the last of them.
+ *
+ * @param article The article to copy.
+ * @return a pointer to the new article.
+ */
+Article* shareArticle(const Article* article) {
+    Article* copy = malloc(sizeof(Article));
+    *copy = *article;
+    Payload* payload = (Payload*)(article->text - offsetof(Payload, text));
+    __atomic_add_fetch(&payload->refs, 1, __ATOMIC_RELAXED);
+    return copy;
+}
+
+/**
+ * Frees an article, and its text unless another copy of the article still shares it.
+ *
+ * @param article The article to free.
+ */
+void freeArticle(Article* article) {
+    Payload* payload = (Payload*)(article->text - offsetof(Payload, text));
+    if (__atomic_sub_fetch(&payload->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(payload);
+    }
+    free(article);
+}
+
+/**
+ * Returns the bytes the allocator reserved for an article and its text, with its overhead.
+ *
+ * @param article The article.
+ * @return The bytes.
+ */
+size_t articleFootprint(const Article* article) {
+    const Payload* payload = (const Payload*)(article->text - offsetof(Payload, text));
+    return malloc_usable_size((void*)article) + malloc_usable_size((void*)payload);
+}
+
+/**
+ * Checks whether an article is the "DONE" message a stage sends when it has finished.
+ *
+ * @param article The article to check.
+ * @return 1 for a "DONE" message, 0 otherwise.
+ */
+int isDone(const Article* article) {
+    return article->done;
+}
+
+/**
+ * Chooses the priority lane a queue should serve next: the most urgent non-empty lane, except that
+ * after config.starvationLimit articles in a row were served ahead of waiting lower lanes, one article
+ * of the lower lane is served. A "DONE" message is never served ahead of its turn, since it must be
+ * the last article a consumer receives from its producer.
+ *
+ * @param laneCount The number of articles in each lane.
+ * @param heads     The first article of each lane (undefined for empty lanes).
+ * @param served    The number of articles served in a row ahead of a waiting lower lane.
+ * @return The lane to serve, or -1 if all lanes are empty.
+ */
+int selectLane(const int laneCount[], Article* const heads[], int* served) {
+    int lane = 0;
+    while (lane < NUM_PRIORITIES && laneCount[lane] == 0) {
+        lane++;
+    }
+    if (lane == NUM_PRIORITIES) {
+        return -1;
+    }
+
+    // find the most urgent lower lane that is waiting
+    int waiting = lane + 1;
+    while (waiting < NUM_PRIORITIES && (laneCount[waiting] == 0 || isDone(heads[waiting]))) {
+        waiting++;
+    }
+    if (waiting == NUM_PRIORITIES) {
+        *served = 0;
+        return lane;
+    }
+
+    // starvation protection
+    if (*served >= config.starvationLimit) {
+        *served = 0;
+        return waiting;
+    }
+    (*served)++;
+    return lane;
+}
@@ -0,0 +1,60 @@
+#ifndef ARTICLE_H
+#define ARTICLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "../Config/Config.h"
+#include "../Queue/Queue.h"
+
+// Priority lanes, from the most urgent one. Every queue serves its lanes in this order.
+#define PRIORITY_HIGH 0
+#define PRIORITY_NORMAL 1
+#define NUM_PRIORITIES 2
+
+// The text of an article, shared by the copies of an article routed to several categories (see
+// shareArticle), and freed along with the last of them.
+typedef struct {
+    int refs;
+    char text[];
+} Payload;
+
+/**
+ * An article flowing through the system. The queues pass articles by pointer: whoever removes an
+ * article from a queue owns it, and the last stage (the screen manager) frees it.
+ * The text lives in a Payload, which copies of the article may share.
+ */
+typedef struct {
+    char* text;
+    int priority;
+    int producer; // index of the producer that created the article, -1 if none
+    int seq;      // position among the articles the dispatcher forwarded from the same producer
+    long intendedNs; // intended send time of a rate-controlled producer's article, 0 if none
+    uint64_t id;     // journal id, 0 if the article isn't journaled
+    uint64_t auditId; // number given by the exactly-once audit, 0 if the article isn't audited
+    int done;         // 1 for the "DONE" message a stage sends when it has finished (see newDone)
+} Article;
+
+// A FIFO ring of article pointers, the lane of a buffer (see Queue.h).
+DEFINE_RING(ArticleRing, Article*)
+
+Article* newArticle(const char* text, int priority);
+
+Article* newArticleFromBytes(const char* text, size_t length, int priority);
+
+Article* newDone();
+
+Article* shareArticle(const Article* article);
+
+void freeArticle(Article* article);
+
+size_t articleFootprint(const Article* article);
+
+int isDone(const Article* article);
+
+int selectLane(const int laneCount[], Article* const heads[], int* served);
+
+#endif
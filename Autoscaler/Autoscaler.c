@@ -0,0 +1,232 @@
+#include "Autoscaler.h"
+
+/**
+ * The autoscaling controller: a thread that samples every category queue each AUTOSCALE_INTERVAL_MS,
+ * and sizes its pool of co-editor workers (its desk) between the AUTOSCALE bounds.
+ *
+ * A category is behind when the articles in its queue would wait longer than the AUTOSCALE target
+ * at the rate its workers took articles during the last interval; after AUTOSCALE_UP_SAMPLES such
+ * samples in a row, a worker is added. A category is idle when its queue is empty and its workers
+ * spent most of the interval waiting for articles; after AUTOSCALE_DOWN_SAMPLES such samples in a
+ * row, a worker is retired. The gap between the two conditions, and the longer streak needed to
+ * retire, keep the pool from thrashing.
+ */
+typedef struct {
+    Desk* desks;
+    int numDesks;
+    sem_t stop;
+    pthread_t thread;
+    int running;
+} Autoscaler;
+
+static Autoscaler autoscaler;
+
+/**
+ * Initializes the desk of a category, without any worker.
+ *
+ * @param desk   The desk.
+ * @param queue  The category queue its workers take articles from.
+ * @param run    The worker thread.
+ * @param worker The argument of the worker thread.
+ */
+void initDesk(Desk* desk, UnboundedBuffer* queue, void* (*run)(void*), void* worker) {
+    desk->queue = queue;
+    desk->run = run;
+    desk->worker = worker;
+    sem_init(&desk->mutex, 0, 1);
+    desk->workers = 0;
+    desk->retiring = 0;
+    desk->done = NULL;
+    desk->threadsCapacity = 8;
+    desk->threads = malloc(sizeof(pthread_t) * desk->threadsCapacity);
+    desk->numThreads = 0;
+    desk->idleNs = 0;
+    desk->taken = 0;
+    desk->lastIdleNs = 0;
+    desk->lastTaken = 0;
+    desk->behind = 0;
+    desk->idle = 0;
+    desk->peakWorkers = 0;
+    desk->added = 0;
+    desk->retired = 0;
+}
+
+/**
+ * Starts a worker at a desk, unless its category is done.
+ */
+void addWorker(Desk* desk) {
+    sem_wait(&desk->mutex);
+    if (desk->done == NULL) {
+        if (desk->numThreads == desk->threadsCapacity) {
+            desk->threadsCapacity *= 2;
+            desk->threads = realloc(desk->threads, sizeof(pthread_t) * desk->threadsCapacity);
+        }
+        pthread_create(&desk->threads[desk->numThreads++], NULL, desk->run, desk->worker);
+        desk->workers++;
+        desk->added++;
+        if (desk->workers > desk->peakWorkers) {
+            desk->peakWorkers = desk->workers;
+        }
+    }
+    sem_post(&desk->mutex);
+}
+
+/**
+ * Tells a worker whether it should leave: its category is done, or the controller retires a worker
+ * (the worker that asks first is the one retired). Called between two articles.
+ *
+ * @return 1 if the worker should leave (see leaveDesk), 0 otherwise.
+ */
+int leaveRequested(Desk* desk) {
+    sem_wait(&desk->mutex);
+    int leave = desk->done != NULL;
+    if (!leave && desk->retiring > 0) {
+        desk->retiring--;
+        desk->retired++;
+        leave = 1;
+    }
+    sem_post(&desk->mutex);
+    return leave;
+}
+
+/**
+ * Keeps the category's DONE, taken by a worker, until the last worker leaves. The other workers
+ * leave once they are done with the articles they took.
+ */
+void takeDone(Desk* desk, Article* done) {
+    sem_wait(&desk->mutex);
+    desk->done = done;
+    sem_post(&desk->mutex);
+}
+
+/**
+ * Leaves a desk, when its worker ends.
+ *
+ * @return The category's DONE when the last worker leaves a done category (the caller passes it
+ *         on), NULL otherwise.
+ */
+Article* leaveDesk(Desk* desk) {
+    sem_wait(&desk->mutex);
+    desk->workers--;
+    Article* done = desk->workers == 0 ? desk->done : NULL;
+    sem_post(&desk->mutex);
+    return done;
+}
+
+/**
+ * Counts the articles a worker took, and the time it waited for them.
+ */
+void countTaken(Desk* desk, int numArticles, long waitedNs) {
+    __atomic_fetch_add(&desk->taken, numArticles, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&desk->idleNs, waitedNs, __ATOMIC_RELAXED);
+}
+
+/**
+ * Samples a desk and adds or retires a worker when the category has been behind, or idle, long enough.
+ */
+static void scaleDesk(Desk* desk) {
+    sem_wait(&desk->queue->mutex);
+    int depth = desk->queue->count;
+    sem_post(&desk->queue->mutex);
+
+    long idleNs = __atomic_load_n(&desk->idleNs, __ATOMIC_RELAXED);
+    long taken = __atomic_load_n(&desk->taken, __ATOMIC_RELAXED);
+    long idleDelta = idleNs - desk->lastIdleNs;
+    long takenDelta = taken - desk->lastTaken;
+    desk->lastIdleNs = idleNs;
+    desk->lastTaken = taken;
+
+    sem_wait(&desk->mutex);
+    int done = desk->done != NULL;
+    int workers = desk->workers - desk->retiring;
+    sem_post(&desk->mutex);
+    if (done || workers <= 0) {
+        return;
+    }
+
+    // how long an article arriving now would wait, at the rate of the last interval
+    long waitMs = takenDelta > 0 ? (long)depth * AUTOSCALE_INTERVAL_MS / takenDelta
+                                 : (depth > 0 ? config.autoscaleWaitMs + 1 : 0);
+    int behind = waitMs > config.autoscaleWaitMs;
+    int idle = depth == 0 && idleDelta > (long)workers * AUTOSCALE_INTERVAL_MS * 1000000L / 2;
+    desk->behind = behind ? desk->behind + 1 : 0;
+    desk->idle = idle ? desk->idle + 1 : 0;
+
+    if (desk->behind >= AUTOSCALE_UP_SAMPLES && workers < config.autoscaleMax) {
+        addWorker(desk);
+        desk->behind = 0;
+    } else if (desk->idle >= AUTOSCALE_DOWN_SAMPLES && workers > config.autoscaleMin) {
+        sem_wait(&desk->mutex);
+        desk->retiring++;
+        sem_post(&desk->mutex);
+        desk->idle = 0;
+    }
+}
+
+/**
+ * The controller thread, until stopAutoscaler.
+ */
+static void* autoscale(void* arg) {
+    TRACE_THREAD("autoscaler", 0);
+    while (1) {
+        struct timespec deadline;
+        deadlineAfterMs(&deadline, AUTOSCALE_INTERVAL_MS);
+        if (sem_timedwait(&autoscaler.stop, &deadline) == 0) {
+            break;
+        }
+        for (int i = 0; i < autoscaler.numDesks; i++) {
+            scaleDesk(&autoscaler.desks[i]);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Starts the controller of the desks, each with its AUTOSCALE minimum of workers.
+ *
+ * @param desks    The desks, one per category.
+ * @param numDesks The number of desks.
+ */
+void startAutoscaler(Desk* desks, int numDesks) {
+    autoscaler.desks = desks;
+    autoscaler.numDesks = numDesks;
+    for (int i = 0; i < numDesks; i++) {
+        for (int k = 0; k < config.autoscaleMin; k++) {
+            addWorker(&desks[i]);
+        }
+        // the initial workers don't count as added
+        desks[i].added = 0;
+    }
+    sem_init(&autoscaler.stop, 0, 0);
+    pthread_create(&autoscaler.thread, NULL, autoscale, NULL);
+    autoscaler.running = 1;
+}
+
+/**
+ * Stops the controller, once every category is done, and reports how each desk was scaled.
+ */
+void stopAutoscaler() {
+    if (!autoscaler.running) {
+        return;
+    }
+    sem_post(&autoscaler.stop);
+    pthread_join(autoscaler.thread, NULL);
+    sem_destroy(&autoscaler.stop);
+    autoscaler.running = 0;
+    for (int i = 0; i < autoscaler.numDesks; i++) {
+        Desk* desk = &autoscaler.desks[i];
+        fprintf(stderr, "Autoscaler: category %d: peak %d workers, %ld added, %ld retired\n", i, desk->peakWorkers,
+                desk->added, desk->retired);
+    }
+}
+
+/**
+ * Waits for every worker a desk started, and frees it. The controller must be stopped.
+ */
+void destroyDesk(Desk* desk) {
+    for (int i = 0; i < desk->numThreads; i++) {
+        pthread_join(desk->threads[i], NULL);
+    }
+    free(desk->threads);
+    sem_destroy(&desk->mutex);
+}
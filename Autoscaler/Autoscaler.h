@@ -0,0 +1,68 @@
+#ifndef AUTOSCALER_H
+#define AUTOSCALER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+
+#include "../Config/Config.h"
+#include "../Article/Article.h"
+#include "../UnBoundedBuffer/UnBoundedBuffer.h"
+#include "../LoadGenerator/LoadGenerator.h"
+
+// How often the controller samples the category queues, and the longest an idle worker waits
+// before it checks whether it was retired.
+#define AUTOSCALE_INTERVAL_MS 100
+// Samples in a row a category must be behind before a worker is added, or idle before one is retired.
+#define AUTOSCALE_UP_SAMPLES 2
+#define AUTOSCALE_DOWN_SAMPLES 10
+
+/**
+ * The co-editor workers of a category, when AUTOSCALE is set. They share the category queue; the
+ * controller adds workers while the queue falls behind and retires them while they sit idle.
+ * The worker that takes the category's DONE keeps it, and the last worker to leave passes it on.
+ */
+typedef struct {
+    UnboundedBuffer* queue;
+    void* (*run)(void*); // the worker thread
+    void* worker;        // its argument
+    sem_t mutex;         // protects the fields below
+    int workers;         // running
+    int retiring;        // asked to leave, the first workers to check leave
+    Article* done;       // the category's DONE, once a worker took it
+    pthread_t* threads;  // every worker started, joined at the end
+    int numThreads;
+    int threadsCapacity;
+    long idleNs;         // time the workers spent waiting for articles (atomic)
+    long taken;          // articles the workers took from the queue (atomic)
+    // controller state and statistics
+    long lastIdleNs;
+    long lastTaken;
+    int behind;
+    int idle;
+    int peakWorkers;
+    long added;
+    long retired;
+} Desk;
+
+void initDesk(Desk* desk, UnboundedBuffer* queue, void* (*run)(void*), void* worker);
+
+void addWorker(Desk* desk);
+
+int leaveRequested(Desk* desk);
+
+void takeDone(Desk* desk, Article* done);
+
+Article* leaveDesk(Desk* desk);
+
+void countTaken(Desk* desk, int numArticles, long waitedNs);
+
+void startAutoscaler(Desk* desks, int numDesks);
+
+void stopAutoscaler();
+
+void destroyDesk(Desk* desk);
+
+#endif
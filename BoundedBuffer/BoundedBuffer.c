@@ -7,12 +7,39 @@
  * @return a pointer to a Bounded buffer
  */
 BoundedBuffer* initBuffer(int bufferSize) {
-    BoundedBuffer* buffer = malloc(sizeof(BoundedBuffer));
-    buffer->data = malloc(sizeof(char*)*bufferSize);
+    // allocate on a cache line boundary, so adjacent buffers don't share a line
+    BoundedBuffer* buffer;
+    if (posix_memalign((void**)&buffer, CACHE_LINE_SIZE, sizeof(BoundedBuffer)) != 0) {
+        return NULL;
+    }
+    initBufferAt(buffer, bufferSize);
+    return buffer;
+}
+
+/**
+ * Initializes a bounded buffer in memory provided by the caller, e.g. in an array of buffers (as the
+ * buffer benchmark lays them out). Freed with destroyBufferAt.
+ *
+ * @param buffer     The memory of the buffer.
+ * @param bufferSize The size of the bounded buffer.
+ */
+void initBufferAt(BoundedBuffer* buffer, int bufferSize) {
+#ifdef STATIC_PIPELINE
+    if (bufferSize > STATIC_QUEUE_CAPACITY) {
+        fprintf(stderr, "Queue size %d is above the %d of this static build, using %d.\n", bufferSize,
+                STATIC_QUEUE_CAPACITY, STATIC_QUEUE_CAPACITY);
+        bufferSize = STATIC_QUEUE_CAPACITY;
+    }
+#endif
+    for (int lane = 0; lane < NUM_PRIORITIES; lane++) {
+        LaneRingInit(&buffer->lanes[lane], bufferSize);
+    }
     buffer->size = bufferSize;
+    buffer->shared = NULL;
+    buffer->account = NULL;
+    buffer->selector = NULL;
     buffer->count = 0;
-    buffer->in = 0;
-    buffer->out = 0;
+    buffer->served = 0;
 
     // Initialize the mutex semaphore to 1
     sem_init(&buffer->mutex, 0, 1);
@@ -20,57 +47,363 @@ BoundedBuffer* initBuffer(int bufferSize) {
     sem_init(&buffer->empty, 0, bufferSize);
     // Initialize the full semaphore to 0
     sem_init(&buffer->full, 0, 0);
+    initWaitState(&buffer->emptyWait);
+    initWaitState(&buffer->fullWait);
+}
 
+/**
+ * Initializes a bounded buffer that is a view of a ring in shared memory: inserting copies the
+ * article into the ring (and frees it), and removing copies it back out.
+ *
+ * @param ring The ring, owned by the caller.
+ * @return a pointer to a Bounded buffer
+ */
+BoundedBuffer* initSharedBuffer(ShmRing* ring) {
+    BoundedBuffer* buffer = initBuffer(1);
+    if (buffer != NULL) {
+        buffer->shared = ring;
+    }
     return buffer;
 }
 
 /**
- * Inserts an article into the bounded buffer.
+ * Inserts an article into the lane of its priority in the bounded buffer.
  * If the buffer is full, the function will block until there is an empty slot available.
+ * The buffer takes ownership of the article.
  *
  * @param buffer The pointer to the bounded buffer.
- * @param s The string representing the article to be inserted.
+ * @param article The article to be inserted.
  */
-void insertBounded(BoundedBuffer* buffer, char* s) {
+void insertBounded(BoundedBuffer* buffer, Article* article) {
+    if (buffer->shared != NULL) {
+        shmRingPush(buffer->shared, article);
+        freeArticle(article);
+        return;
+    }
     // decrements the value of empty by 1 and continues.
-    // If the value is 0 (no empty slot available), the thread will be blocked until an empty slot becomes available.
-    sem_wait(&buffer->empty);
+    // If the value is 0 (no empty slot available), the thread will wait (see acquireSlots) until an empty slot becomes available.
+    TRACE_BEGIN(wait);
+    acquireSlots(&buffer->empty, &buffer->emptyWait, 1, -1);
+    TRACE_END(wait, "insertBounded:wait");
+    TRACE_BEGIN(enqueue);
     //acquiring the mutex semaphore
     sem_wait(&buffer->mutex);
 
     // critical section
-    buffer->data[buffer->in] = strdup(s);
-    buffer->in = (buffer->in + 1) % buffer->size;
+    LaneRingPush(&buffer->lanes[article->priority], article);
     buffer->count++;
+    if (buffer->account != NULL) {
+        chargeMemory(buffer->account, 1, articleFootprint(article));
+    }
 
     // releasing the mutex and allowing other threads to access the buffer.
     sem_post(&buffer->mutex);
     // increments the value of the full semaphore by 1, indicating that there is now one more filled slot in the buffer.
     sem_post(&buffer->full);
+    // wake up a consumer that waits on several buffers
+    Selector* selector = __atomic_load_n(&buffer->selector, __ATOMIC_ACQUIRE);
+    if (selector != NULL) {
+        sem_post(&selector->ready);
+    }
+    TRACE_END(enqueue, "insertBounded");
 }
 
 /**
- * Removes an article from the bounded buffer.
- * If the buffer is empty, the function will block until there is a filled slot available.
- *
- * @param buffer The pointer to the bounded buffer.
- * @return The string representing the removed article.
+ * Takes the next article out of the buffer, serving the priority lanes in order (see selectLane).
+ * The caller already holds one of the full slots.
  */
-char* removeBounded(BoundedBuffer* buffer) {
-    // decrements the value of full by 1 and continues.
-    // If the value is 0 (no filled slot available), the thread will be blocked until a filled slot becomes available.
-    sem_wait(&buffer->full);
+static Article* takeArticle(BoundedBuffer* buffer) {
+    TRACE_BEGIN(dequeue);
     // acquiring the mutex
     sem_wait(&buffer->mutex);
 
     // critical section
-    char* s = buffer->data[buffer->out];
-    buffer->out = (buffer->out + 1) % buffer->size;
+    int laneCount[NUM_PRIORITIES];
+    Article* heads[NUM_PRIORITIES];
+    for (int lane = 0; lane < NUM_PRIORITIES; lane++) {
+        laneCount[lane] = buffer->lanes[lane].count;
+        heads[lane] = laneCount[lane] > 0 ? *LaneRingPeek(&buffer->lanes[lane]) : NULL;
+    }
+    Article* article;
+    LaneRingPop(&buffer->lanes[selectLane(laneCount, heads, &buffer->served)], &article);
     buffer->count--;
+    if (buffer->account != NULL) {
+        chargeMemory(buffer->account, -1, -(long)articleFootprint(article));
+    }
     
     // releasing the mutex and allowing other threads to access the buffer.
     sem_post(&buffer->mutex);
     // increments the value of the empty semaphore by 1, indicating that an empty slot is available in the buffer.
     sem_post(&buffer->empty);
-    return s;
-}
\ No newline at end of file
+    TRACE_END(dequeue, "removeBounded");
+    return article;
+}
+
+/**
+ * Removes an article, the way every variant below does: waits for a filled slot (see acquireSlots),
+ * then takes the article from the lane to serve.
+ *
+ * @param buffer    The pointer to the bounded buffer.
+ * @param timeoutMs The longest time to wait, in milliseconds: -1 as long as it takes, 0 not at all.
+ * @return The removed article, owned by the caller, or NULL if the buffer stayed empty.
+ */
+static Article* removeArticle(BoundedBuffer* buffer, long timeoutMs) {
+    if (buffer->shared != NULL) {
+        return shmRingPop(buffer->shared, timeoutMs);
+    }
+    // decrements the value of full by 1 and continues.
+    // If the value is 0 (no filled slot available), the thread will wait until a filled slot becomes available.
+    TRACE_BEGIN(wait);
+    int taken = acquireSlots(&buffer->full, &buffer->fullWait, 1, timeoutMs);
+    TRACE_END(wait, "removeBounded:wait");
+    return taken > 0 ? takeArticle(buffer) : NULL;
+}
+
+/**
+ * Removes an article from the bounded buffer, serving the priority lanes in order (see selectLane).
+ * If the buffer is empty, the function will block until there is a filled slot available.
+ *
+ * @param buffer The pointer to the bounded buffer.
+ * @return The removed article, owned by the caller.
+ */
+Article* removeBounded(BoundedBuffer* buffer) {
+    return removeArticle(buffer, -1);
+}
+
+/**
+ * Removes an article from the bounded buffer if there is one, without waiting.
+ *
+ * @param buffer The pointer to the bounded buffer.
+ * @return The removed article, owned by the caller, or NULL if the buffer is empty.
+ */
+Article* tryRemoveBounded(BoundedBuffer* buffer) {
+    return removeArticle(buffer, 0);
+}
+
+/**
+ * Removes an article from the bounded buffer, waiting while it is empty, but no longer than a timeout.
+ *
+ * @param buffer    The pointer to the bounded buffer.
+ * @param timeoutMs The longest time to wait, in milliseconds.
+ * @return The removed article, owned by the caller, or NULL if the buffer stayed empty.
+ */
+Article* timedRemoveBounded(BoundedBuffer* buffer, long timeoutMs) {
+    // a timeout that already passed doesn't wait
+    return removeArticle(buffer, timeoutMs > 0 ? timeoutMs : 0);
+}
+
+/**
+ * Initializes a selector.
+ *
+ * @param selector The selector.
+ */
+void initSelector(Selector* selector) {
+    sem_init(&selector->ready, 0, 0);
+    initWaitState(&selector->readyWait);
+    selector->next = 0;
+}
+
+/**
+ * Makes a buffer post a selector on every insertion. A buffer is watched by at most one selector,
+ * and may already be in use.
+ *
+ * @param buffer   The pointer to the bounded buffer.
+ * @param selector The selector.
+ */
+void watchBuffer(BoundedBuffer* buffer, Selector* selector) {
+    __atomic_store_n(&buffer->selector, selector, __ATOMIC_RELEASE);
+}
+
+/**
+ * Removes an article from whichever of several buffers has one first, scanning them round robin.
+ * While they are all empty it waits on the selector, which all of them must be watched by (see
+ * watchBuffer). The posts are drained before every scan, since the scan sees the articles behind
+ * them; an insertion racing with the scan leaves the selector posted, so it is never missed.
+ *
+ * @param selector   The selector watching the buffers.
+ * @param buffers    The buffers.
+ * @param numBuffers The number of buffers.
+ * @param timeoutMs  The longest time to wait, in milliseconds, -1 to wait as long as it takes.
+ * @param index      Set to the index of the buffer the article came from.
+ * @return The removed article, owned by the caller, or NULL if all the buffers stayed empty.
+ */
+Article* selectBounded(Selector* selector, BoundedBuffer* const buffers[], int numBuffers, long timeoutMs, int* index) {
+    struct timespec deadline;
+    if (timeoutMs >= 0) {
+        deadlineAfterMs(&deadline, timeoutMs);
+    }
+    while (1) {
+        // the scan below finds the articles of the insertions posted so far, don't wake up for them again
+        while (sem_trywait(&selector->ready) == 0) {
+        }
+        int polled = 0;
+        for (int n = 0; n < numBuffers; n++) {
+            int i = (selector->next + n) % numBuffers;
+            polled |= buffers[i]->shared != NULL;
+            Article* article = tryRemoveBounded(buffers[i]);
+            if (article != NULL) {
+                selector->next = (i + 1) % numBuffers;
+                *index = i;
+                return article;
+            }
+        }
+
+        // nothing to take: wait for an insertion
+        const struct timespec* until = timeoutMs >= 0 ? &deadline : NULL;
+        struct timespec poll;
+        if (polled) {
+            deadlineAfterMs(&poll, SELECT_POLL_MS);
+            if (until == NULL || poll.tv_sec < until->tv_sec
+                || (poll.tv_sec == until->tv_sec && poll.tv_nsec < until->tv_nsec)) {
+                until = &poll;
+            }
+        }
+        TRACE_BEGIN(wait);
+        int result = waitForUntil(&selector->ready, &selector->readyWait, until);
+        TRACE_END(wait, "selectBounded:wait");
+        if (result != 0 && until != &poll) {
+            return NULL;
+        }
+    }
+}
+
+/**
+ * Frees the resources of a selector. No buffer may post it anymore.
+ *
+ * @param selector The selector.
+ */
+void destroySelector(Selector* selector) {
+    sem_destroy(&selector->ready);
+}
+
+/**
+ * Reads the number of articles in the buffer and its capacity, for reporting.
+ *
+ * @param buffer The pointer to the bounded buffer.
+ * @param count  Set to the number of articles in the buffer.
+ * @param size   Set to the capacity of the buffer.
+ */
+void bufferOccupancy(BoundedBuffer* buffer, int* count, int* size) {
+    if (buffer->shared != NULL) {
+        sem_wait(&buffer->shared->mutex);
+        *count = buffer->shared->count;
+        *size = buffer->shared->capacity;
+        sem_post(&buffer->shared->mutex);
+        return;
+    }
+    sem_wait(&buffer->mutex);
+    *count = buffer->count;
+    *size = buffer->size;
+    sem_post(&buffer->mutex);
+}
+
+/**
+ * Returns the bytes the allocator reserved for a bounded buffer and its rings.
+ */
+static long bufferFootprint(BoundedBuffer* buffer) {
+    long bytes = malloc_usable_size(buffer);
+#ifndef STATIC_PIPELINE
+    // the slots of the specialized build are inside the struct
+    for (int lane = 0; lane < NUM_PRIORITIES; lane++) {
+        bytes += malloc_usable_size(buffer->lanes[lane].slots);
+    }
+#endif
+    return bytes;
+}
+
+/**
+ * Counts a bounded buffer, and the articles inside it, in the memory account of its stage.
+ * Must be called before the buffer is shared with another thread.
+ *
+ * @param buffer  The pointer to the bounded buffer.
+ * @param account The account, NULL when memory accounting is disabled.
+ */
+void accountBuffer(BoundedBuffer* buffer, MemoryAccount* account) {
+    if (account == NULL || buffer->shared != NULL) {
+        return;
+    }
+    buffer->account = account;
+    chargeQueue(account, bufferFootprint(buffer));
+    for (int lane = 0; lane < NUM_PRIORITIES; lane++) {
+        for (int i = 0; i < buffer->lanes[lane].count; i++) {
+            chargeMemory(account, 1, articleFootprint(*LaneRingAt(&buffer->lanes[lane], i)));
+        }
+    }
+}
+
+/**
+ * Changes the capacity of a bounded buffer while it is in use, keeping the articles inside it in
+ * order. Shrinking first takes the slots that go away from the producers, so it waits until the
+ * consumers have made enough room, and gives up (leaving the buffer as it was) if they don't in
+ * time. Only one resize may run at a time.
+ *
+ * @param buffer    The pointer to the bounded buffer.
+ * @param newSize   The new capacity.
+ * @param timeoutMs The longest time a shrink waits for room, in milliseconds.
+ * @return 0 on success, -1 if the buffer can't be resized, -2 if the room didn't come in time.
+ */
+int resizeBuffer(BoundedBuffer* buffer, int newSize, long timeoutMs) {
+    if (buffer->shared != NULL || newSize <= 0) {
+        return -1;
+    }
+#ifdef STATIC_PIPELINE
+    if (newSize > STATIC_QUEUE_CAPACITY) {
+        return -1;
+    }
+#endif
+    int oldSize = buffer->size;
+    // the consumer may stop draining the buffer (its producer retired), wait for the room until a deadline
+    struct timespec deadline;
+    deadlineAfterMs(&deadline, timeoutMs);
+    for (int taken = 0; taken < oldSize - newSize; taken++) {
+        if (sem_trywait(&buffer->empty) != 0 && waitForUntil(&buffer->empty, &buffer->emptyWait, &deadline) != 0) {
+            for (int i = 0; i < taken; i++) {
+                sem_post(&buffer->empty);
+            }
+            return -2;
+        }
+    }
+
+    sem_wait(&buffer->mutex);
+    long oldBytes = bufferFootprint(buffer);
+    for (int lane = 0; lane < NUM_PRIORITIES; lane++) {
+        LaneRingResize(&buffer->lanes[lane], newSize);
+    }
+    buffer->size = newSize;
+    chargeQueue(buffer->account, bufferFootprint(buffer) - oldBytes);
+    sem_post(&buffer->mutex);
+
+    for (int i = oldSize; i < newSize; i++) {
+        sem_post(&buffer->empty);
+    }
+    return 0;
+}
+
+/**
+ * Frees a bounded buffer, along with the articles still inside it.
+ * No thread may use the buffer anymore. The ring of a shared buffer is left to its owner.
+ *
+ * @param buffer The pointer to the bounded buffer.
+ */
+void destroyBuffer(BoundedBuffer* buffer) {
+    destroyBufferAt(buffer);
+    free(buffer);
+}
+
+/**
+ * Frees the resources of a bounded buffer initialized with initBufferAt, along with the articles
+ * still inside it, but not its memory.
+ *
+ * @param buffer The pointer to the bounded buffer.
+ */
+void destroyBufferAt(BoundedBuffer* buffer) {
+    for (int lane = 0; lane < NUM_PRIORITIES; lane++) {
+        for (int i = 0; i < buffer->lanes[lane].count; i++) {
+            freeArticle(*LaneRingAt(&buffer->lanes[lane], i));
+        }
+        LaneRingDestroy(&buffer->lanes[lane]);
+    }
+    sem_destroy(&buffer->mutex);
+    sem_destroy(&buffer->empty);
+    sem_destroy(&buffer->full);
+}
@@ -3,22 +3,101 @@
 
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "../cacheline.h"
+#include "../Article/Article.h"
+#include "../WaitStrategy/WaitStrategy.h"
+#include "../ShmRing/ShmRing.h"
+#include "../Trace/Trace.h"
+#include "../Memory/Memory.h"
+
+// The longest a selectBounded over buffers in shared memory sleeps before it scans them again: the
+// processes that fill them can't post the selector of this process.
+#define SELECT_POLL_MS 1
+
+// The ring of a lane. The specialized build (make static) knows the largest queue of its
+// configuration, and keeps the slots inline in a power-of-two ring indexed by mask.
+#ifdef STATIC_PIPELINE
+DEFINE_STATIC_RING(LaneRing, Article*, STATIC_QUEUE_CAPACITY)
+#else
+DEFINE_RING(LaneRing, Article*)
+#endif
+
+/**
+ * Lets a consumer wait on several bounded buffers at once (see selectBounded): every buffer it
+ * watches posts the ready semaphore when an article is inserted.
+ */
 typedef struct {
-    char** data;
-    int count; // number of articles currently in the buffer
-    int in; // the index where the next element will be inserted in the buffer
-    int out; // the index from where the next element will be removed from the buffer
+    CACHE_ALIGNED sem_t ready;
+    WaitState readyWait;
+    int next; // the buffer the next scan starts from, so the buffers are served round robin
+} CACHE_ALIGNED Selector;
+
+/**
+ * A bounded buffer of articles with a FIFO ring per priority lane. The capacity is shared by all the
+ * lanes (every ring can hold the whole capacity), and removal serves the lanes by priority.
+ *
+ * The fields are grouped by the side that writes them: the producer side (empty) and the
+ * consumer side (full) each start on their own cache line, and the struct itself is allocated
+ * cache-line aligned so that buffers allocated back to back never share a line.
+ *
+ * A buffer may instead be a view of a ring in shared memory (see initSharedBuffer), when the stages
+ * on its two sides run as separate processes.
+ */
+typedef struct {
+    // read-only after initialization
     int size;
-    sem_t mutex;
-    sem_t empty;
-    sem_t full;
-} BoundedBuffer;
+    ShmRing* shared; // the ring the buffer is a view of, NULL for a buffer of this process
+    MemoryAccount* account; // the memory account of the buffer's stage, NULL when not accounted
+
+    // shared state, only touched while holding the mutex
+    CACHE_ALIGNED sem_t mutex;
+    int count; // number of articles currently in the buffer
+    LaneRing lanes[NUM_PRIORITIES];
+    int served; // articles served in a row ahead of a waiting lower lane
+
+    // producer side
+    CACHE_ALIGNED sem_t empty;
+    WaitState emptyWait;
+    Selector* selector; // posted on every insertion once a consumer watches the buffer, NULL before
+
+    // consumer side
+    CACHE_ALIGNED sem_t full;
+    WaitState fullWait;
+} CACHE_ALIGNED BoundedBuffer;
 
 BoundedBuffer* initBuffer(int bufferSize);
 
-void insertBounded(BoundedBuffer* buffer, char* s);
+void initBufferAt(BoundedBuffer* buffer, int bufferSize);
+
+BoundedBuffer* initSharedBuffer(ShmRing* ring);
+
+void insertBounded(BoundedBuffer* buffer, Article* article);
+
+Article* removeBounded(BoundedBuffer* buffer);
+
+Article* tryRemoveBounded(BoundedBuffer* buffer);
+
+Article* timedRemoveBounded(BoundedBuffer* buffer, long timeoutMs);
+
+void initSelector(Selector* selector);
+
+void watchBuffer(BoundedBuffer* buffer, Selector* selector);
+
+Article* selectBounded(Selector* selector, BoundedBuffer* const buffers[], int numBuffers, long timeoutMs, int* index);
+
+void destroySelector(Selector* selector);
+
+void bufferOccupancy(BoundedBuffer* buffer, int* count, int* size);
+
+int resizeBuffer(BoundedBuffer* buffer, int newSize, long timeoutMs);
+
+void accountBuffer(BoundedBuffer* buffer, MemoryAccount* account);
+
+void destroyBuffer(BoundedBuffer* buffer);
 
-char* removeBounded(BoundedBuffer* buffer);
+void destroyBufferAt(BoundedBuffer* buffer);
 
-#endif
\ No newline at end of file
+#endif
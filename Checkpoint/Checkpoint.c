@@ -0,0 +1,320 @@
+#include "Checkpoint.h"
+#include "../globals.h"
+
+/**
+ * Checkpoints of a stopped run. With CHECKPOINT, SIGINT or SIGTERM stop the run instead of killing
+ * it: the producers stop generating and send their DONE, the dispatcher forwards what they sent, and
+ * the co-editors set aside the articles still waiting in their queues (see checkpointArticle)
+ * instead of editing them. The articles already edited are displayed. Once every thread is done, the
+ * progress of the producers and the set aside articles are written to the checkpoint file.
+ *
+ * The next run maps the checkpoint: its producers skip the articles sent before, and the set aside
+ * articles go straight back to their category queues (see restoreCheckpoint).
+ */
+typedef struct {
+    int enabled;
+    int stopping;
+    int closing;
+    pthread_t signalThread;
+    sigset_t signals;
+    // the set aside articles of every category (the workers of a category share them, see AUTOSCALE)
+    sem_t mutex;
+    Article** articles[NUM_MESSAGE_TYPES];
+    long numArticles[NUM_MESSAGE_TYPES];
+    long capacity[NUM_MESSAGE_TYPES];
+    // the mapped checkpoint of the previous run
+    char* map;
+    size_t mapSize;
+} Checkpointer;
+
+static Checkpointer checkpointer;
+
+/**
+ * Waits for SIGINT or SIGTERM, which every other thread blocks, and asks the run to stop.
+ */
+static void* signalWatcher(void* arg) {
+    int signal;
+    while (sigwait(&checkpointer.signals, &signal) == 0) {
+        if (__atomic_load_n(&checkpointer.closing, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        if (!__atomic_exchange_n(&checkpointer.stopping, 1, __ATOMIC_ACQ_REL)) {
+            fprintf(stderr, "Checkpoint: stopping, the queued articles go to %s\n", config.checkpointPath);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Maps the checkpoint of the previous run, if there is one, and lets its producers skip the articles
+ * they sent before. A producer only resumes if it is the same one (type and id) at the same index.
+ */
+static void loadCheckpoint() {
+    int fd = open(config.checkpointPath, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            fprintf(stderr, "Error opening checkpoint %s.\n", config.checkpointPath);
+        }
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CheckpointHeader)) {
+        fprintf(stderr, "Checkpoint: ignoring the truncated %s\n", config.checkpointPath);
+        close(fd);
+        return;
+    }
+    char* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return;
+    }
+    const CheckpointHeader* header = (const CheckpointHeader*)map;
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0
+        || header->numCategories != NUM_MESSAGE_TYPES
+        || sizeof(CheckpointHeader) + (size_t)header->numProducers * sizeof(CheckpointProducer) > (size_t)st.st_size) {
+        fprintf(stderr, "Checkpoint: ignoring %s, not a checkpoint of this system\n", config.checkpointPath);
+        munmap(map, st.st_size);
+        return;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    checkpointer.map = map;
+    checkpointer.mapSize = st.st_size;
+
+    const CheckpointProducer* progress = (const CheckpointProducer*)(header + 1);
+    for (int i = 0; i < header->numProducers && i < numProducers; i++) {
+        if (progress[i].type == (int32_t)producers[i]->type && progress[i].producerID == producers[i]->producerID) {
+            producers[i]->resumeAt = progress[i].progress;
+        } else {
+            fprintf(stderr, "Checkpoint: producer %d changed, it starts over\n", i);
+        }
+    }
+}
+
+/**
+ * Starts checkpointing, when CHECKPOINT is set: loads the checkpoint of the previous run, and has a
+ * thread watch for the signals that stop the run. Must be called before any thread starts (they
+ * inherit the blocked signals), and after the producers are created.
+ */
+void startCheckpoint() {
+    if (config.checkpointPath == NULL) {
+        return;
+    }
+    // the journal would replay the set aside articles a second time
+    if (config.journalPath != NULL) {
+        fprintf(stderr, "CHECKPOINT can't be used with JOURNAL, not checkpointing.\n");
+        return;
+    }
+    sem_init(&checkpointer.mutex, 0, 1);
+    for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+        checkpointer.capacity[i] = 1024;
+        checkpointer.articles[i] = malloc(sizeof(Article*) * checkpointer.capacity[i]);
+        checkpointer.numArticles[i] = 0;
+    }
+    loadCheckpoint();
+
+    sigemptyset(&checkpointer.signals);
+    sigaddset(&checkpointer.signals, SIGINT);
+    sigaddset(&checkpointer.signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &checkpointer.signals, NULL);
+    pthread_create(&checkpointer.signalThread, NULL, signalWatcher, NULL);
+    checkpointer.enabled = 1;
+}
+
+/**
+ * Tells whether the run was asked to stop (and checkpoint) by a signal.
+ */
+int checkpointRequested() {
+    return __atomic_load_n(&checkpointer.stopping, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Sets aside a queued article of a stopping run, for the checkpoint. It leaves this run, so the
+ * audit counts it as dropped.
+ *
+ * @param category The category queue the article was taken from.
+ * @param article  The article, the checkpoint takes ownership of it.
+ */
+void checkpointArticle(int category, Article* article) {
+    sem_wait(&checkpointer.mutex);
+    if (checkpointer.numArticles[category] == checkpointer.capacity[category]) {
+        checkpointer.capacity[category] *= 2;
+        checkpointer.articles[category] = realloc(checkpointer.articles[category],
+                                                  sizeof(Article*) * checkpointer.capacity[category]);
+    }
+    checkpointer.articles[category][checkpointer.numArticles[category]++] = article;
+    sem_post(&checkpointer.mutex);
+    auditDropped(article);
+}
+
+// a restored article and the sequence number it had in the previous run
+typedef struct {
+    Article* article;
+    int seq;
+} Restored;
+
+static int compareRestored(const void* a, const void* b) {
+    const Restored* first = a;
+    const Restored* second = b;
+    if (first->article->producer != second->article->producer) {
+        return first->article->producer < second->article->producer ? -1 : 1;
+    }
+    return first->seq < second->seq ? -1 : first->seq > second->seq;
+}
+
+/**
+ * Puts the articles of the mapped checkpoint back into their category queues, in the order they were
+ * queued, and unmaps it. Called once the queues are initialized, before any admission policy
+ * applies to them (the articles were admitted by the previous run) and before the dispatcher starts.
+ * In the ordered output mode, the articles of every producer are renumbered from 0, and the
+ * dispatcher numbers the producer's new articles after them (see resumedSeq).
+ *
+ * @param queues        The category queues.
+ * @param numCategories The number of categories.
+ */
+void restoreCheckpoint(UnboundedBuffer* queues, int numCategories) {
+    if (checkpointer.map == NULL) {
+        return;
+    }
+    const CheckpointHeader* header = (const CheckpointHeader*)checkpointer.map;
+    const char* position = checkpointer.map + sizeof(CheckpointHeader)
+                           + (size_t)header->numProducers * sizeof(CheckpointProducer);
+    const char* end = checkpointer.map + checkpointer.mapSize;
+    // a damaged count can't claim more records than the file holds
+    long capacity = checkpointer.mapSize / sizeof(CheckpointRecord) + 1;
+    if (header->numArticles >= 0 && header->numArticles < capacity) {
+        capacity = header->numArticles + 1;
+    }
+    Restored* restored = malloc(sizeof(Restored) * capacity);
+    Article** articles = malloc(sizeof(Article*) * capacity);
+    int16_t* categories = malloc(sizeof(int16_t) * capacity);
+
+    long count = 0;
+    while (count < header->numArticles && position + sizeof(CheckpointRecord) <= end) {
+        const CheckpointRecord* record = (const CheckpointRecord*)position;
+        size_t size = sizeof(CheckpointRecord) + ((record->length + 7) & ~(size_t)7);
+        if (size > (size_t)(end - position) || record->category < 0 || record->category >= numCategories
+            || record->priority < 0 || record->priority >= NUM_PRIORITIES) {
+            fprintf(stderr, "Checkpoint: ignoring a damaged record in %s\n", config.checkpointPath);
+            break;
+        }
+        Article* article = newArticleFromBytes((const char*)(record + 1), record->length, record->priority);
+        // the producers added through the control channel aren't there anymore
+        article->producer = record->producer < numProducers ? record->producer : -1;
+        auditProduced(article);
+        restored[count] = (Restored){article, record->seq};
+        articles[count] = article;
+        categories[count] = record->category;
+        position += size;
+        count++;
+    }
+    munmap(checkpointer.map, checkpointer.mapSize);
+    checkpointer.map = NULL;
+
+    // renumber before inserting: a spilled article is freed by the queue
+    if (config.orderedWindow > 0) {
+        qsort(restored, count, sizeof(Restored), compareRestored);
+        for (long i = 0; i < count; i++) {
+            Article* article = restored[i].article;
+            if (article->producer >= 0) {
+                article->seq = producers[article->producer]->resumedSeq++;
+            }
+        }
+    }
+    // the records are grouped by category, insert every group under a single lock
+    for (long i = 0; i < count;) {
+        long run = i;
+        while (run < count && categories[run] == categories[i]) {
+            run++;
+        }
+        insertUnBoundedBatch(&queues[categories[i]], articles + i, run - i);
+        i = run;
+    }
+    free(restored);
+    free(articles);
+    free(categories);
+    fprintf(stderr, "Checkpoint: resumed %ld queued articles from %s\n", count, config.checkpointPath);
+}
+
+/**
+ * Writes the checkpoint file: the progress of the producers and the set aside articles. It is
+ * written to a temporary file and renamed over the old one, so a crash leaves either checkpoint.
+ *
+ * @return 0 on success, -1 on a write error.
+ */
+static int writeCheckpoint() {
+    char tempPath[4096];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", config.checkpointPath);
+    FILE* file = fopen(tempPath, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+    CheckpointHeader header = {.numProducers = numProducers, .numCategories = NUM_MESSAGE_TYPES, .numArticles = 0};
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+        header.numArticles += checkpointer.numArticles[i];
+    }
+    fwrite(&header, sizeof(header), 1, file);
+    for (int i = 0; i < numProducers; i++) {
+        CheckpointProducer progress = {.type = producers[i]->type, .producerID = producers[i]->producerID,
+                                       .progress = producers[i]->progress};
+        fwrite(&progress, sizeof(progress), 1, file);
+    }
+    static const char padding[8] = {0};
+    for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+        for (long k = 0; k < checkpointer.numArticles[i]; k++) {
+            const Article* article = checkpointer.articles[i][k];
+            CheckpointRecord record = {.length = strlen(article->text), .priority = article->priority,
+                                       .category = i, .producer = article->producer, .seq = article->seq};
+            fwrite(&record, sizeof(record), 1, file);
+            fwrite(article->text, 1, record.length, file);
+            fwrite(padding, 1, ((record.length + 7) & ~7u) - record.length, file);
+        }
+    }
+
+    int failed = fflush(file) != 0 || fsync(fileno(file)) != 0;
+    failed |= fclose(file) != 0;
+    if (failed || rename(tempPath, config.checkpointPath) != 0) {
+        unlink(tempPath);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Ends checkpointing, once every thread is done. A stopped run writes its checkpoint; a run that
+ * went to completion removes the checkpoint it resumed from, so the next run starts over.
+ */
+void finishCheckpoint() {
+    if (!checkpointer.enabled) {
+        return;
+    }
+    __atomic_store_n(&checkpointer.closing, 1, __ATOMIC_RELEASE);
+    pthread_kill(checkpointer.signalThread, SIGTERM);
+    pthread_join(checkpointer.signalThread, NULL);
+
+    if (checkpointRequested()) {
+        long count = 0;
+        for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+            count += checkpointer.numArticles[i];
+        }
+        if (writeCheckpoint() != 0) {
+            fprintf(stderr, "Error writing checkpoint %s.\n", config.checkpointPath);
+        } else {
+            fprintf(stderr, "Checkpoint: saved %d producers and %ld queued articles to %s\n", numProducers, count,
+                    config.checkpointPath);
+        }
+    } else {
+        unlink(config.checkpointPath);
+    }
+    for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+        for (long k = 0; k < checkpointer.numArticles[i]; k++) {
+            freeArticle(checkpointer.articles[i][k]);
+        }
+        free(checkpointer.articles[i]);
+    }
+    sem_destroy(&checkpointer.mutex);
+    checkpointer.enabled = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../Config/Config.h"
+#include "../Article/Article.h"
+#include "../UnBoundedBuffer/UnBoundedBuffer.h"
+
+#define CHECKPOINT_MAGIC "NEWSCKP1"
+
+// The start of a checkpoint file, followed by a CheckpointProducer per producer, then the queued articles.
+typedef struct {
+    char magic[8];
+    int32_t numProducers;
+    int32_t numCategories;
+    int64_t numArticles;
+} CheckpointHeader;
+
+// The progress of a producer: the articles it sent before the run was stopped.
+typedef struct {
+    int32_t type;
+    int32_t producerID;
+    int32_t progress;
+    int32_t reserved;
+} CheckpointProducer;
+
+// A queued article, followed by its text (padded to 8 bytes, so the next record stays aligned).
+typedef struct {
+    uint32_t length;
+    int16_t priority;
+    int16_t category;
+    int32_t producer;
+    int32_t seq;
+} CheckpointRecord;
+
+void startCheckpoint();
+
+int checkpointRequested();
+
+void checkpointArticle(int category, Article* article);
+
+void restoreCheckpoint(UnboundedBuffer* queues, int numCategories);
+
+void finishCheckpoint();
+
+#endif
@@ -12,11 +12,16 @@ void coEditorInit(CoEditor *coEditor, Dispatcher *dispatcher, int categoryIndex)
     coEditor->dispatcher = dispatcher;
     coEditor->sharedBuffer = sharedBuffer;
     coEditor->categoryIndex = categoryIndex;
+    coEditor->desk = NULL;
 }
 
 /**
  * Retrieves messages from the designated unbounded queue of a specific category, "edits them", 
  * and passes them to the shared buffer.
+ * With BUNDLE, it takes up to a bundle of articles at a time and edits them in a single edit call.
+ * Once the run is stopped for a checkpoint, the articles it takes are set aside instead of edited.
+ * With AUTOSCALE, it is one of the workers of its category's desk: it leaves when it is retired, and
+ * the category's "DONE" is passed on by the last worker to leave.
  *
  * @param arg A void pointer to the CoEditor instance.
  * @return    The function returns NULL when the thread exits.
@@ -24,51 +29,275 @@ void coEditorInit(CoEditor *coEditor, Dispatcher *dispatcher, int categoryIndex)
 void* coEdit(void* arg) {
     CoEditor* coEditor = (CoEditor*)arg;
     int categoryIndex = coEditor->categoryIndex;
-    pthread_t screenManagerThread;
-    pthread_create(&screenManagerThread, NULL, screenManager, (void*)&sharedBuffer);
-
-    while (1) {
-        // Receive message from Dispatcher queue
-        char* message = removeUnBounded(&coEditor->dispatcher->dispatcherQueues[categoryIndex]);
-
-        // Edit the message (block for 0.1 seconds)
-        usleep(100000);  // 0.1 seconds
-        
-        // Check for "DONE" message
-        if (strcmp(message, "DONE") == 0) {
-            // Pass the "DONE" message without waiting
-            insertBounded(coEditor->sharedBuffer, message);
+    TRACE_THREAD("co-editor %d", categoryIndex);
+    Article** bundle = malloc(sizeof(Article*) * config.bundleSize);
+    UnboundedBuffer* queue = &coEditor->dispatcher->dispatcherQueues[categoryIndex];
+    Desk* desk = coEditor->desk;
+
+    int done = 0;
+    while (!done) {
+        // Receive messages from Dispatcher queue
+        int numArticles;
+        if (desk == NULL) {
+            numArticles = removeUnBoundedBatch(queue, bundle, config.bundleSize);
+        } else {
+            // a worker waits for a while at most, to see whether it should leave
+            if (leaveRequested(desk)) {
+                break;
+            }
+            long startNs = monotonicNs();
+            numArticles = timedRemoveUnBoundedBatch(queue, bundle, config.bundleSize, AUTOSCALE_INTERVAL_MS);
+            countTaken(desk, numArticles, monotonicNs() - startNs);
+            if (numArticles == 0) {
+                continue;
+            }
+        }
+        if (checkpointRequested()) {
+            for (int i = 0; i < numArticles; i++) {
+                done = isDone(bundle[i]);
+                if (done && desk != NULL) {
+                    takeDone(desk, bundle[i]);
+                } else if (done) {
+                    insertBounded(coEditor->sharedBuffer, bundle[i]);
+                } else {
+                    checkpointArticle(categoryIndex, bundle[i]);
+                }
+            }
+            continue;
+        }
+
+        // Edit the messages (block for 0.1 seconds, the overhead of an edit call)
+        TRACE_BEGIN(edit);
+        usleep(EDIT_TIME_US);  // 0.1 seconds
+        TRACE_END(edit, "coEdit");
+        jitter();
+
+        for (int i = 0; i < numArticles; i++) {
+            // Check for "DONE" message, the last one of the queue
+            done = isDone(bundle[i]);
+            if (done && desk != NULL) {
+                // the other workers may still be editing
+                takeDone(desk, bundle[i]);
+                continue;
+            }
+            recordStage(bundle[i], STAGE_EDITED);
+            // Pass the edited message (or "DONE", without waiting) to the shared buffer
+            insertBounded(coEditor->sharedBuffer, bundle[i]);
+        }
+    }
+    if (desk != NULL) {
+        Article* last = leaveDesk(desk);
+        if (last != NULL) {
+            insertBounded(coEditor->sharedBuffer, last);
+        }
+    }
+    free(bundle);
+    return NULL;
+}
+
+// an article being edited by an event loop co-editor, until its deadline
+typedef struct {
+    long deadlineNs;
+    Article* article;
+} Edit;
+
+/**
+ * Adds an edit to a min-heap of edits ordered by deadline.
+ */
+static void pushEdit(Edit* heap, int* count, Edit edit) {
+    int i = (*count)++;
+    while (i > 0 && heap[(i - 1) / 2].deadlineNs > edit.deadlineNs) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = edit;
+}
+
+/**
+ * Removes the edit with the earliest deadline from a min-heap of edits.
+ */
+static Edit popEdit(Edit* heap, int* count) {
+    Edit first = heap[0];
+    Edit last = heap[--(*count)];
+    int i = 0;
+    while (2 * i + 1 < *count) {
+        int child = 2 * i + 1;
+        if (child + 1 < *count && heap[child + 1].deadlineNs < heap[child].deadlineNs) {
+            child++;
+        }
+        if (last.deadlineNs <= heap[child].deadlineNs) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return first;
+}
+
+/**
+ * Arms the timer for the earliest deadline, or disarms it when nothing is being edited.
+ */
+static void armTimer(int timerFd, const Edit* heap, int count) {
+    struct itimerspec timer = {0};
+    if (count > 0) {
+        timer.it_value.tv_sec = heap[0].deadlineNs / 1000000000L;
+        timer.it_value.tv_nsec = heap[0].deadlineNs % 1000000000L;
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+/**
+ * An event loop co-editor: edits up to EDIT_CONCURRENCY articles of its category at once, on a
+ * single thread. Every edit is a small state machine (waiting in the queue, editing until its
+ * deadline, passed on), driven by an epoll loop over the queue's eventfd and a timerfd armed for the
+ * earliest deadline. The "DONE" message is passed on once the edits started before it are over.
+ * Once the run is stopped for a checkpoint, the edits under way are finished, and the articles still
+ * waiting are set aside.
+ *
+ * @param arg A void pointer to the CoEditor instance.
+ * @return    The function returns NULL when the thread exits.
+ */
+void* coEditLoop(void* arg) {
+    CoEditor* coEditor = (CoEditor*)arg;
+    UnboundedBuffer* queue = &coEditor->dispatcher->dispatcherQueues[coEditor->categoryIndex];
+    TRACE_THREAD("co-editor %d", coEditor->categoryIndex);
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct epoll_event event = {.events = EPOLLIN};
+    event.data.fd = queue->notifyFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, queue->notifyFd, &event);
+    event.data.fd = timerFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+
+    Edit* edits = malloc(sizeof(Edit) * config.editConcurrency);
+    int numEdits = 0;
+    Article* done = NULL;
+    while (done == NULL || numEdits > 0) {
+        // start editing the waiting articles, as far as the concurrency allows
+        while (done == NULL && numEdits < config.editConcurrency) {
+            Article* article = tryRemoveUnBounded(queue);
+            if (article == NULL) {
+                break;
+            }
+            if (isDone(article)) {
+                done = article;
+                break;
+            }
+            if (checkpointRequested()) {
+                checkpointArticle(coEditor->categoryIndex, article);
+                continue;
+            }
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long deadlineNs = now.tv_sec * 1000000000L + now.tv_nsec + EDIT_TIME_US * 1000L;
+            pushEdit(edits, &numEdits, (Edit){deadlineNs, article});
+            if (numEdits == 1 || edits[0].article == article) {
+                armTimer(timerFd, edits, numEdits);
+            }
+        }
+        if (done != NULL && numEdits == 0) {
             break;
         }
-        
-        // Pass the edited message to the shared buffer
-        insertBounded(coEditor->sharedBuffer, message);
+
+        struct epoll_event ready[2];
+        int numReady = epoll_wait(epollFd, ready, 2, -1);
+        for (int i = 0; i < numReady; i++) {
+            uint64_t value;
+            // reset the eventfd / the timer expiration count
+            read(ready[i].data.fd, &value, sizeof(value));
+        }
+
+        // pass on the edits whose deadline passed
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long nowNs = now.tv_sec * 1000000000L + now.tv_nsec;
+        int finished = 0;
+        while (numEdits > 0 && edits[0].deadlineNs <= nowNs) {
+            Article* article = popEdit(edits, &numEdits).article;
+            recordStage(article, STAGE_EDITED);
+            insertBounded(coEditor->sharedBuffer, article);
+            finished = 1;
+            jitter();
+        }
+        if (finished) {
+            armTimer(timerFd, edits, numEdits);
+        }
     }
+
+    // Pass the "DONE" message once every edit is over
+    insertBounded(coEditor->sharedBuffer, done);
+    free(edits);
+    close(timerFd);
+    close(epollFd);
     return NULL;
 }
 
 /**
  * Runs the Co-Editor threads.
  * Creates and starts threads for each Co-Editor in the coEditors array.
+ * With AUTOSCALE, every category gets a desk of workers instead, sized by the autoscaling controller.
  *
  * @param dispatcher Pointer to the Dispatcher object.
- * @return Pointer to the array of Co-Editor thread IDs (pthread_t).
+ * Returns once all of them, and the screen manager, are done (in the multi-process mode, the screen
+ * manager runs in its own process, and only the co-editors are waited for).
  */
-pthread_t* runCoEditors(Dispatcher* dispatcher) {
-    pthread_t coEditorThreads[NUM_CO_EDITORS];
-    CoEditor coEditors[NUM_CO_EDITORS];
+void runCoEditors(Dispatcher* dispatcher) {
+    // the co-editors outlive no one, but keep them off this stack frame anyway
+    pthread_t* coEditorThreads = malloc(sizeof(pthread_t) * NUM_CO_EDITORS);
+    CoEditor* coEditors = malloc(sizeof(CoEditor) * NUM_CO_EDITORS);
+
+    // create the screen manager thread, which displays what all the co-editors pass on
+    // (in the multi-process mode, it runs in a process of its own)
+    pthread_t screenManagerThread;
+    if (!config.processes) {
+        pthread_create(&screenManagerThread, NULL, screenManager, NULL);
+    }
+
+    // an event loop co-editor already edits several articles at once, it isn't scaled
+    Desk* desks = NULL;
+    if (config.autoscaleMin > 0 && config.editConcurrency > 1) {
+        fprintf(stderr, "AUTOSCALE can't be used with EDIT_CONCURRENCY, running a co-editor per category.\n");
+    } else if (config.autoscaleMin > 0) {
+        desks = malloc(sizeof(Desk) * NUM_CO_EDITORS);
+    }
 
     // create all co-Editor's threads
     for (int i = 0; i < NUM_CO_EDITORS; i++) {
         coEditorInit(&coEditors[i], dispatcher, i);
-        pthread_create(&coEditorThreads[i], NULL, coEdit, (void*)&coEditors[i]);
+        if (desks != NULL) {
+            // the workers of a category share its CoEditor
+            initDesk(&desks[i], &dispatcher->dispatcherQueues[i], coEdit, &coEditors[i]);
+            coEditors[i].desk = &desks[i];
+            continue;
+        }
+        // with EDIT_CONCURRENCY, a co-editor edits several articles at once on an event loop
+        void* (*run)(void*) = dispatcher->dispatcherQueues[i].notifyFd >= 0 ? coEditLoop : coEdit;
+        pthread_create(&coEditorThreads[i], NULL, run, (void*)&coEditors[i]);
+    }
+    if (desks != NULL) {
+        startAutoscaler(desks, NUM_CO_EDITORS);
     }
 
 
     // Wait for all Co-Editor threads to finish
-    for (int i = 0; i < NUM_CO_EDITORS; i++) {
-        pthread_join(coEditorThreads[i], NULL);
+    if (desks == NULL) {
+        for (int i = 0; i < NUM_CO_EDITORS; i++) {
+            pthread_join(coEditorThreads[i], NULL);
+        }
+    }
+    if (!config.processes) {
+        pthread_join(screenManagerThread, NULL);
     }
-    printf("DONE\n");
-    return coEditorThreads;
-}
\ No newline at end of file
+    // the last worker of every desk passed its DONE on, so no worker is added anymore
+    if (desks != NULL) {
+        stopAutoscaler();
+        for (int i = 0; i < NUM_CO_EDITORS; i++) {
+            destroyDesk(&desks[i]);
+        }
+        free(desks);
+    }
+    free(coEditors);
+    free(coEditorThreads);
+}
@@ -4,22 +4,33 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h> 
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 
 #include "../UnBoundedBuffer/UnBoundedBuffer.h"
 #include "../BoundedBuffer/BoundedBuffer.h"
 #include "../Dispatcher/Dispatcher.h"
+#include "../ScreenManager/ScreenManager.h"
+#include "../Autoscaler/Autoscaler.h"
+
+// how long editing an article takes
+#define EDIT_TIME_US 100000
 
 typedef struct {
     char message[22];
     Dispatcher *dispatcher;
     BoundedBuffer *sharedBuffer;
     int categoryIndex;
+    Desk* desk; // the workers of the category with AUTOSCALE, NULL for a single co-editor
 } CoEditor;
 
 void coEditorInit(CoEditor *coEditor, Dispatcher *dispatcher, int categoryIndex);
 
 void* coEdit(void* arg);
 
-pthread_t* runCoEditors(Dispatcher* dispatcher);
+void* coEditLoop(void* arg);
+
+void runCoEditors(Dispatcher* dispatcher);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "Compress.h"
+
+/**
+ * A small LZ77 codec in the style of LZ4, for the repetitive text of the articles. A block is a
+ * sequence of (literals, match) pairs, each starting with a token byte: the high nibble holds the
+ * number of literals and the low nibble the match length minus MIN_MATCH, a nibble of 15 being
+ * continued by extra bytes (255 meaning "more follows"). The literals come next, then the 16-bit
+ * offset of the match. The last pair of a block has literals only.
+ *
+ * Both sides start with a preset dictionary in front of the block, so even a short block can
+ * refer back to the words every article repeats.
+ */
+static const char dictionary[] =
+    "Producer 0 SPORTS 0\nProducer 1 NEWS 1\nProducer 2 WEATHER 2\nProducer 3 SPORTS 3\n"
+    "Producer 4 NEWS 4\nProducer 5 WEATHER 5\nProducer 6 SPORTS 6\nProducer 7 NEWS 7\n"
+    "Producer 8 WEATHER 8\nProducer 9 SPORTS 9\nDONE\n";
+
+#define DICTIONARY_SIZE (sizeof(dictionary) - 1)
+
+static uint32_t read32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hash(uint32_t value) {
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * Writes a length that didn't fit in its nibble (the part above 15).
+ */
+static char* writeLength(char* out, size_t length) {
+    while (length >= 255) {
+        *out++ = (char)255;
+        length -= 255;
+    }
+    *out++ = (char)length;
+    return out;
+}
+
+/**
+ * Writes a pair: the literals, then the match (if matchLength is 0, the pair is the last one).
+ */
+static char* writePair(char* out, const char* literals, size_t numLiterals, size_t offset, size_t matchLength) {
+    size_t extraMatch = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+    *out++ = (char)(((numLiterals < 15 ? numLiterals : 15) << 4) | (extraMatch < 15 ? extraMatch : 15));
+    if (numLiterals >= 15) {
+        out = writeLength(out, numLiterals - 15);
+    }
+    memcpy(out, literals, numLiterals);
+    out += numLiterals;
+    if (matchLength > 0) {
+        *out++ = (char)(offset & 0xff);
+        *out++ = (char)(offset >> 8);
+        if (extraMatch >= 15) {
+            out = writeLength(out, extraMatch - 15);
+        }
+    }
+    return out;
+}
+
+/**
+ * Compresses a block.
+ *
+ * @param in     The block.
+ * @param length The length of the block.
+ * @param out    Where to write the compressed block, of at least COMPRESS_BOUND(length) bytes.
+ * @return The size of the compressed block.
+ */
+size_t compressBlock(const char* in, size_t length, char* out) {
+    // the window is the dictionary followed by the block, matches are searched with a hash table of
+    // the last position of every 4-byte sequence
+    size_t end = DICTIONARY_SIZE + length;
+    char* window = malloc(end);
+    memcpy(window, dictionary, DICTIONARY_SIZE);
+    memcpy(window + DICTIONARY_SIZE, in, length);
+    int32_t* table = malloc(sizeof(int32_t) << HASH_BITS);
+    memset(table, 0xff, sizeof(int32_t) << HASH_BITS);
+    for (size_t pos = 0; pos + MIN_MATCH <= DICTIONARY_SIZE; pos++) {
+        table[hash(read32(window + pos))] = pos;
+    }
+
+    char* start = out;
+    size_t anchor = DICTIONARY_SIZE, pos = DICTIONARY_SIZE;
+    while (pos + MIN_MATCH <= end) {
+        uint32_t h = hash(read32(window + pos));
+        int32_t candidate = table[h];
+        table[h] = pos;
+        if (candidate < 0 || pos - candidate > MAX_OFFSET || read32(window + candidate) != read32(window + pos)) {
+            pos++;
+            continue;
+        }
+        size_t matchLength = MIN_MATCH;
+        while (pos + matchLength < end && window[candidate + matchLength] == window[pos + matchLength]) {
+            matchLength++;
+        }
+        out = writePair(out, window + anchor, pos - anchor, pos - candidate, matchLength);
+        pos += matchLength;
+        anchor = pos;
+    }
+    out = writePair(out, window + anchor, end - anchor, 0, 0);
+
+    free(table);
+    free(window);
+    return out - start;
+}
+
+/**
+ * Reads a length that didn't fit in its nibble.
+ */
+static int readLength(const char** in, const char* inEnd, size_t* length) {
+    unsigned char byte;
+    do {
+        if (*in >= inEnd) {
+            return -1;
+        }
+        byte = (unsigned char)*(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+/**
+ * Decompresses a block.
+ *
+ * @param in     The compressed block.
+ * @param size   The size of the compressed block.
+ * @param out    Where to write the block.
+ * @param length The length of the block.
+ * @return 0 on success, -1 if the compressed block is corrupt.
+ */
+int decompressBlock(const char* in, size_t size, char* out, size_t length) {
+    const char* inEnd = in + size;
+    size_t pos = 0;
+    while (in < inEnd) {
+        unsigned char token = (unsigned char)*in++;
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15 && readLength(&in, inEnd, &numLiterals) != 0) {
+            return -1;
+        }
+        if (numLiterals > (size_t)(inEnd - in) || numLiterals > length - pos) {
+            return -1;
+        }
+        memcpy(out + pos, in, numLiterals);
+        in += numLiterals;
+        pos += numLiterals;
+        if (in == inEnd) {
+            // the last pair
+            break;
+        }
+
+        if (inEnd - in < 2) {
+            return -1;
+        }
+        size_t offset = (unsigned char)in[0] | ((unsigned char)in[1] << 8);
+        in += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && readLength(&in, inEnd, &matchLength) != 0) {
+            return -1;
+        }
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > DICTIONARY_SIZE + pos || matchLength > length - pos) {
+            return -1;
+        }
+        // copy byte by byte: the match may overlap what it produces, or start in the dictionary
+        for (size_t i = 0; i < matchLength; i++, pos++) {
+            size_t from = DICTIONARY_SIZE + pos - offset;
+            out[pos] = from < DICTIONARY_SIZE ? dictionary[from] : out[from - DICTIONARY_SIZE];
+        }
+    }
+    return pos == length ? 0 : -1;
+}
+
+/**
+ * Compresses a block into a frame: a FrameHeader followed by the compressed block.
+ *
+ * @param in     The block.
+ * @param length The length of the block.
+ * @param out    Where to write the frame, of at least sizeof(FrameHeader) + COMPRESS_BOUND(length) bytes.
+ * @return The size of the frame.
+ */
+size_t compressFrame(const char* in, size_t length, char* out) {
+    FrameHeader header = {.length = length};
+    header.size = compressBlock(in, length, out + sizeof(header));
+    memcpy(out, &header, sizeof(header));
+    return sizeof(header) + header.size;
+}
+
+/**
+ * Writes the whole buffer, retrying on short writes.
+ */
+static int writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        size -= written;
+    }
+    return 0;
+}
+
+/**
+ * Compresses the batched text and writes it as a frame.
+ */
+static int flushBlock(CompressedWriter* writer) {
+    if (writer->blockSize == 0) {
+        return 0;
+    }
+    size_t frameSize = compressFrame(writer->block, writer->blockSize, writer->frame);
+    writer->rawBytes += writer->blockSize;
+    writer->storedBytes += frameSize;
+    writer->blockSize = 0;
+    return writeAll(writer->fd, writer->frame, frameSize);
+}
+
+/**
+ * Creates (or truncates) a compressed file.
+ *
+ * @param writer The writer to initialize.
+ * @param path   The file.
+ * @return 0 on success, -1 if the file can't be created.
+ */
+int openCompressedWriter(CompressedWriter* writer, const char* path) {
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (writer->fd < 0) {
+        fprintf(stderr, "Error creating %s.\n", path);
+        return -1;
+    }
+    writer->block = malloc(COMPRESS_BLOCK_SIZE);
+    writer->blockSize = 0;
+    writer->frame = malloc(sizeof(FrameHeader) + COMPRESS_BOUND(COMPRESS_BLOCK_SIZE));
+    writer->rawBytes = 0;
+    writer->storedBytes = 0;
+    return 0;
+}
+
+/**
+ * Appends text to a compressed file. It reaches the file once its block is full.
+ *
+ * @param writer The writer.
+ * @param data   The text.
+ * @param length The length of the text.
+ * @return 0 on success, -1 if a write failed.
+ */
+int compressedWrite(CompressedWriter* writer, const char* data, size_t length) {
+    while (length > 0) {
+        size_t chunk = COMPRESS_BLOCK_SIZE - writer->blockSize;
+        if (chunk > length) {
+            chunk = length;
+        }
+        memcpy(writer->block + writer->blockSize, data, chunk);
+        writer->blockSize += chunk;
+        data += chunk;
+        length -= chunk;
+        if (writer->blockSize == COMPRESS_BLOCK_SIZE && flushBlock(writer) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Writes the last block and closes a compressed file.
+ *
+ * @param writer The writer.
+ * @return 0 on success, -1 if a write failed.
+ */
+int closeCompressedWriter(CompressedWriter* writer) {
+    int result = flushBlock(writer);
+    if (close(writer->fd) != 0) {
+        result = -1;
+    }
+    free(writer->block);
+    free(writer->frame);
+    return result;
+}
+
+/**
+ * Decompresses a file written by a CompressedWriter.
+ *
+ * @param path The compressed file.
+ * @param out  Where to write the text.
+ * @return 0 on success, -1 if the file can't be read or is corrupt.
+ */
+int decompressFile(const char* path, FILE* out) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening %s.\n", path);
+        return -1;
+    }
+    int result = 0;
+    FrameHeader header;
+    while (fread(&header, sizeof(header), 1, file) == 1) {
+        char* frame = malloc(header.size);
+        char* block = malloc(header.length);
+        if (fread(frame, 1, header.size, file) != header.size
+            || decompressBlock(frame, header.size, block, header.length) != 0) {
+            fprintf(stderr, "%s: corrupt frame\n", path);
+            result = -1;
+        } else {
+            fwrite(block, 1, header.length, out);
+        }
+        free(frame);
+        free(block);
+        if (result != 0) {
+            break;
+        }
+    }
+    fclose(file);
+    return result;
+}
@@ -0,0 +1,58 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// the shortest repetition worth encoding as a match
+#define MIN_MATCH 4
+// matches reach back up to this many bytes (their offsets are 16 bits)
+#define MAX_OFFSET 65535
+#define HASH_BITS 13
+
+// the largest size a block of a given length may compress to
+#define COMPRESS_BOUND(length) ((length) + (length) / 255 + 16)
+
+// the header of a compressed frame in a file, followed by the compressed block
+typedef struct {
+    uint32_t length; // of the block before compression
+    uint32_t size;   // of the compressed block
+} FrameHeader;
+
+// the size of the batches a CompressedWriter compresses
+#define COMPRESS_BLOCK_SIZE (64 * 1024)
+
+/**
+ * Writes text to a file in compressed frames: the text is batched, and every COMPRESS_BLOCK_SIZE
+ * bytes are compressed and written as one frame. Read it back with decompressFile.
+ */
+typedef struct {
+    int fd;
+    char* block;
+    size_t blockSize;
+    char* frame;
+    // statistics
+    long rawBytes;
+    long storedBytes;
+} CompressedWriter;
+
+size_t compressBlock(const char* in, size_t length, char* out);
+
+int decompressBlock(const char* in, size_t size, char* out, size_t length);
+
+size_t compressFrame(const char* in, size_t length, char* out);
+
+int openCompressedWriter(CompressedWriter* writer, const char* path);
+
+int compressedWrite(CompressedWriter* writer, const char* data, size_t length);
+
+int closeCompressedWriter(CompressedWriter* writer);
+
+int decompressFile(const char* path, FILE* out);
+
+#endif
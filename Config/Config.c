@@ -0,0 +1,252 @@
+#include "Config.h"
+
+Config config;
+
+/**
+ * Sets all the options to their default values.
+ */
+void initConfig() {
+    config.waitStrategy = WAIT_BLOCK;
+    config.spinLimit = 4000;
+    config.starvationLimit = 8;
+    config.breakingEvery = 0;
+    config.orderedWindow = 0;
+    config.dedupCapacity = 0;
+    config.dedupTtlMs = 0;
+    config.rate = 0;
+    config.arrival = ARRIVAL_CONSTANT;
+    config.rampRate = 0;
+    config.rampStepMs = 0;
+    config.rampSloMs = 0;
+    config.journalPath = NULL;
+    config.journalCommitMs = 5;
+    config.recover = 0;
+    config.spillDir = NULL;
+    config.spillThreshold = 0;
+    config.processes = 0;
+    config.controlPath = NULL;
+    config.numPolicies = 0;
+    config.numSubscriptions = 0;
+    config.audit = 0;
+    config.jitterUs = 0;
+    config.tracePath = NULL;
+    config.editConcurrency = 1;
+    config.autoscaleMin = 0;
+    config.autoscaleMax = 0;
+    config.autoscaleWaitMs = 500;
+    config.bundleSize = 1;
+    config.bundleTimeoutMs = 0;
+    config.compress = 0;
+    config.outputPath = NULL;
+    config.recordPath = NULL;
+    config.replayPath = NULL;
+    config.checkpointPath = NULL;
+    config.memoryReportMs = -1;
+}
+
+/**
+ * Parses a single "KEY value" line of the configuration file and applies it.
+ *
+ * @param line The configuration line.
+ * @return 0 on success, -1 if the option is unknown or its value is invalid.
+ */
+int parseOption(const char* line) {
+    char key[64], value[256];
+    int keyLength = 0;
+    if (sscanf(line, "%63s%n", key, &keyLength) < 1) {
+        return -1;
+    }
+    // the value is the rest of the line, without the surrounding whitespace
+    value[0] = '\0';
+    sscanf(line + keyLength, " %255[^\n]", value);
+    for (int i = strlen(value) - 1; i >= 0 && (value[i] == ' ' || value[i] == '\r' || value[i] == '\t'); i--) {
+        value[i] = '\0';
+    }
+
+    if (strcmp(key, "WAIT_STRATEGY") == 0) {
+        if (strcmp(value, "block") == 0) {
+            config.waitStrategy = WAIT_BLOCK;
+        } else if (strcmp(value, "spin") == 0) {
+            config.waitStrategy = WAIT_SPIN;
+        } else if (strcmp(value, "adaptive") == 0) {
+            config.waitStrategy = WAIT_ADAPTIVE;
+        } else {
+            fprintf(stderr, "Unknown wait strategy: %s\n", value);
+            return -1;
+        }
+    } else if (strcmp(key, "SPIN_LIMIT") == 0) {
+        config.spinLimit = atoi(value);
+    } else if (strcmp(key, "STARVATION_LIMIT") == 0) {
+        config.starvationLimit = atoi(value);
+    } else if (strcmp(key, "BREAKING_EVERY") == 0) {
+        config.breakingEvery = atoi(value);
+    } else if (strcmp(key, "ORDERED_OUTPUT") == 0) {
+        config.orderedWindow = value[0] != '\0' ? atoi(value) : 64;
+    } else if (strcmp(key, "DEDUP") == 0) {
+        if (sscanf(value, "%d %ld", &config.dedupCapacity, &config.dedupTtlMs) < 1) {
+            config.dedupCapacity = 65536;
+        }
+    } else if (strcmp(key, "RATE") == 0) {
+        char arrival[32] = "constant";
+        sscanf(value, "%lf %31s", &config.rate, arrival);
+        if (strcmp(arrival, "constant") == 0) {
+            config.arrival = ARRIVAL_CONSTANT;
+        } else if (strcmp(arrival, "poisson") == 0) {
+            config.arrival = ARRIVAL_POISSON;
+        } else if (strcmp(arrival, "bursty") == 0) {
+            config.arrival = ARRIVAL_BURSTY;
+        } else {
+            fprintf(stderr, "Unknown arrival distribution: %s\n", arrival);
+            return -1;
+        }
+    } else if (strcmp(key, "RAMP") == 0) {
+        if (sscanf(value, "%lf %ld %ld", &config.rampRate, &config.rampStepMs, &config.rampSloMs) != 3) {
+            fprintf(stderr, "Invalid RAMP option: %s\n", value);
+            config.rampStepMs = 0;
+            return -1;
+        }
+    } else if (strcmp(key, "JOURNAL") == 0) {
+        char path[256];
+        if (sscanf(value, "%255s %ld", path, &config.journalCommitMs) < 1) {
+            fprintf(stderr, "Invalid JOURNAL option: %s\n", value);
+            return -1;
+        }
+        free(config.journalPath);
+        config.journalPath = strdup(path);
+    } else if (strcmp(key, "RECOVER") == 0) {
+        config.recover = value[0] == '\0' || atoi(value) != 0;
+    } else if (strcmp(key, "SPILL") == 0) {
+        char dir[256];
+        if (sscanf(value, "%255s %d", dir, &config.spillThreshold) != 2 || config.spillThreshold <= 0) {
+            fprintf(stderr, "Invalid SPILL option: %s\n", value);
+            config.spillThreshold = 0;
+            return -1;
+        }
+        free(config.spillDir);
+        config.spillDir = strdup(dir);
+    } else if (strcmp(key, "PROCESSES") == 0) {
+        config.processes = value[0] == '\0' || atoi(value) != 0;
+    } else if (strcmp(key, "CONTROL") == 0) {
+#ifdef STATIC_PIPELINE
+        // the specialized build is generated for a fixed set of producers
+        fprintf(stderr, "CONTROL isn't available in the static build.\n");
+        return -1;
+#endif
+        char path[256];
+        if (sscanf(value, "%255s", path) != 1) {
+            fprintf(stderr, "Invalid CONTROL option: %s\n", value);
+            return -1;
+        }
+        free(config.controlPath);
+        config.controlPath = strdup(path);
+    } else if (strcmp(key, "POLICY") == 0) {
+        AdmissionPolicy policy = {.probability = 0.1};
+        char type[32];
+        if (sscanf(value, "%15s %31s %d %lf", policy.category, type, &policy.limit, &policy.probability) < 3
+            || policy.limit <= 0 || policy.probability < 0 || policy.probability > 1) {
+            fprintf(stderr, "Invalid POLICY option: %s\n", value);
+            return -1;
+        }
+        if (strcmp(type, "block") == 0) {
+            policy.type = ADMIT_BLOCK;
+        } else if (strcmp(type, "drop-oldest") == 0) {
+            policy.type = ADMIT_DROP_OLDEST;
+        } else if (strcmp(type, "drop-newest") == 0) {
+            policy.type = ADMIT_DROP_NEWEST;
+        } else if (strcmp(type, "sample") == 0) {
+            policy.type = ADMIT_SAMPLE;
+        } else {
+            fprintf(stderr, "Unknown admission policy: %s\n", type);
+            return -1;
+        }
+        // a later policy of the same category replaces the earlier one
+        int i = 0;
+        while (i < config.numPolicies && strcmp(config.policies[i].category, policy.category) != 0) {
+            i++;
+        }
+        if (i == MAX_POLICIES) {
+            fprintf(stderr, "Too many POLICY options\n");
+            return -1;
+        }
+        config.policies[i] = policy;
+        if (i == config.numPolicies) {
+            config.numPolicies++;
+        }
+    } else if (strcmp(key, "SUBSCRIBE") == 0) {
+        Subscription subscription;
+        if (sscanf(value, "%15s %31s", subscription.category, subscription.keyword) != 2) {
+            fprintf(stderr, "Invalid SUBSCRIBE option: %s\n", value);
+            return -1;
+        }
+        if (config.numSubscriptions == MAX_SUBSCRIPTIONS) {
+            fprintf(stderr, "Too many SUBSCRIBE options\n");
+            return -1;
+        }
+        config.subscriptions[config.numSubscriptions++] = subscription;
+    } else if (strcmp(key, "AUDIT") == 0) {
+        config.audit = value[0] == '\0' || atoi(value) != 0;
+    } else if (strcmp(key, "JITTER") == 0) {
+        config.jitterUs = atoi(value);
+    } else if (strcmp(key, "EDIT_CONCURRENCY") == 0) {
+        config.editConcurrency = atoi(value) > 0 ? atoi(value) : 1;
+    } else if (strcmp(key, "AUTOSCALE") == 0) {
+        // "AUTOSCALE <min> <max> [target wait ms]"
+        int fields = sscanf(value, "%d %d %ld", &config.autoscaleMin, &config.autoscaleMax, &config.autoscaleWaitMs);
+        if (fields < 2 || config.autoscaleMin < 1 || config.autoscaleMax < config.autoscaleMin
+            || config.autoscaleWaitMs <= 0) {
+            fprintf(stderr, "Invalid AUTOSCALE option: %s\n", value);
+            config.autoscaleMin = 0;
+            config.autoscaleWaitMs = 500;
+            return -1;
+        }
+    } else if (strcmp(key, "BUNDLE") == 0) {
+        if (sscanf(value, "%d %ld", &config.bundleSize, &config.bundleTimeoutMs) != 2
+            || config.bundleSize <= 0 || config.bundleTimeoutMs < 0) {
+            fprintf(stderr, "Invalid BUNDLE option: %s\n", value);
+            config.bundleSize = 1;
+            return -1;
+        }
+    } else if (strcmp(key, "COMPRESS") == 0) {
+        config.compress = value[0] == '\0' || atoi(value) != 0;
+    } else if (strcmp(key, "COMPRESSED_OUTPUT") == 0) {
+        char path[256];
+        if (sscanf(value, "%255s", path) != 1) {
+            fprintf(stderr, "Invalid COMPRESSED_OUTPUT option: %s\n", value);
+            return -1;
+        }
+        free(config.outputPath);
+        config.outputPath = strdup(path);
+    } else if (strcmp(key, "RECORD") == 0 || strcmp(key, "REPLAY") == 0) {
+        char path[256];
+        if (sscanf(value, "%255s", path) != 1) {
+            fprintf(stderr, "Invalid %s option: %s\n", key, value);
+            return -1;
+        }
+        char** option = strcmp(key, "RECORD") == 0 ? &config.recordPath : &config.replayPath;
+        free(*option);
+        *option = strdup(path);
+    } else if (strcmp(key, "CHECKPOINT") == 0) {
+        char path[256];
+        if (sscanf(value, "%255s", path) != 1) {
+            fprintf(stderr, "Invalid CHECKPOINT option: %s\n", value);
+            return -1;
+        }
+        free(config.checkpointPath);
+        config.checkpointPath = strdup(path);
+    } else if (strcmp(key, "MEMORY") == 0) {
+        // "MEMORY [dump interval ms]"
+        config.memoryReportMs = value[0] == '\0' ? 0 : atol(value);
+        if (config.memoryReportMs < 0) {
+            fprintf(stderr, "Invalid MEMORY option: %s\n", value);
+            config.memoryReportMs = -1;
+            return -1;
+        }
+    } else if (strcmp(key, "TRACE_FILE") == 0) {
+        free(config.tracePath);
+        config.tracePath = strdup(value);
+    } else {
+        fprintf(stderr, "Unknown configuration option: %s\n", key);
+        return -1;
+    }
+    return 0;
+}
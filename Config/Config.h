@@ -0,0 +1,100 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The distributions of the gaps between the articles of a rate-controlled producer.
+typedef enum {
+    ARRIVAL_CONSTANT,
+    ARRIVAL_POISSON,
+    ARRIVAL_BURSTY
+} ArrivalType;
+
+// The ways a thread can wait for a queue to become non-empty / non-full.
+typedef enum {
+    WAIT_BLOCK,     // sleep on the semaphore right away
+    WAIT_SPIN,      // spin up to spinLimit iterations, yield, then sleep
+    WAIT_ADAPTIVE   // like WAIT_SPIN, with the spin budget adapted from recent waits
+} WaitStrategyType;
+
+// What a category queue does with an article that arrives while it holds its limit.
+typedef enum {
+    ADMIT_ALL,          // no limit (the default)
+    ADMIT_BLOCK,        // the dispatcher waits for room
+    ADMIT_DROP_OLDEST,  // the oldest article of the least urgent lane is dropped to make room
+    ADMIT_DROP_NEWEST,  // the arriving article is dropped
+    ADMIT_SAMPLE        // the arriving article is admitted with a probability, dropped otherwise
+} AdmissionType;
+
+// The admission policy of a category, as given by a POLICY option.
+typedef struct {
+    char category[16];
+    AdmissionType type;
+    int limit;
+    double probability; // of ADMIT_SAMPLE
+} AdmissionPolicy;
+
+#define MAX_POLICIES 8
+
+// A SUBSCRIBE option: the desk of a category also receives the articles that mention a keyword.
+typedef struct {
+    char category[16];
+    char keyword[32];
+} Subscription;
+
+#define MAX_SUBSCRIPTIONS 16
+
+/**
+ * Optional settings of the news system. They are given in the configuration file as
+ * "KEY value" lines, which may appear anywhere among the producer lines.
+ */
+typedef struct {
+    WaitStrategyType waitStrategy;
+    int spinLimit;
+    int starvationLimit;
+    int breakingEvery;
+    int orderedWindow; // reorder window of the ordered output mode, 0 when disabled
+    int dedupCapacity; // articles remembered by the dedup stage, 0 when disabled
+    long dedupTtlMs;
+    double rate;       // total articles per second of the generating producers, 0 for as fast as possible
+    ArrivalType arrival;
+    double rampRate;   // rate added every ramp step, 0 when the ramp mode is disabled
+    long rampStepMs;
+    long rampSloMs;
+    char* journalPath; // NULL when journaling is disabled
+    long journalCommitMs;
+    int recover;       // replay the unpublished articles of the journal at startup
+    char* spillDir;
+    int spillThreshold; // articles a category lane holds in memory before spilling, 0 when disabled
+    int processes;     // run the producers and the screen manager as separate processes
+    char* controlPath; // the Unix socket of the control channel, NULL when disabled
+    AdmissionPolicy policies[MAX_POLICIES];
+    int numPolicies;
+    Subscription subscriptions[MAX_SUBSCRIPTIONS];
+    int numSubscriptions;
+    int audit;         // check that every article is displayed or dropped exactly once
+    int jitterUs;      // longest random delay added between the articles of every stage, 0 for none
+    char* tracePath;   // the trace file of a tracing build, NULL for trace.json
+    int editConcurrency; // articles a co-editor edits at once (on an event loop when above 1)
+    int autoscaleMin;    // fewest co-editor workers of a category, 0 when autoscaling is disabled
+    int autoscaleMax;    // most co-editor workers of a category
+    long autoscaleWaitMs; // longest expected wait in a category queue before a worker is added
+    int bundleSize;      // articles of a category the dispatcher bundles together, 1 when bundling is disabled
+    long bundleTimeoutMs; // longest time an article waits for its bundle to fill up
+    int compress;        // compress the spill segments
+    char* outputPath;    // the compressed file the screen manager writes to, NULL for stdout
+    char* recordPath;    // where to write the arrivals and stage times of the run, NULL when not recording
+    char* replayPath;    // a recording whose arrivals replace the configured producers, NULL for none
+    char* checkpointPath; // where a run stopped by a signal saves its progress, and the next one resumes from, NULL when disabled
+    long memoryReportMs; // interval of the memory dumps, 0 for the shutdown summary only, -1 when accounting is disabled
+} Config;
+
+extern Config config;
+
+void initConfig();
+
+int parseOption(const char* line);
+
+#endif
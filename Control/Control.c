@@ -0,0 +1,238 @@
+#include "Control.h"
+
+/**
+ * The control channel: a Unix socket accepting one client at a time, with one command per line and
+ * one reply line per command ("OK ..." or "ERROR ..."):
+ *
+ *   ADD <articles> <queue size>     start a producer generating articles
+ *   INGEST <path> <queue size>      start a producer streaming the lines of a file
+ *   RESIZE SHARED <size>            resize the co-editors' shared buffer
+ *   RESIZE <producer> <size>        resize the queue of a running producer (by index)
+ *   STATUS                          list the producers and the queues
+ *   CLOSE                           no more producers: the system ends once the running ones are done
+ *
+ * While the channel is open, the dispatcher keeps running even when every producer is done.
+ */
+typedef struct {
+    int fd;
+    char* path;
+    int open;
+    pthread_t thread;
+} Control;
+
+static Control control = {.fd = -1};
+
+/**
+ * Sends a reply line to the client. A client that went away doesn't kill the process.
+ */
+static void reply(int client, const char* format, ...) {
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (length > (int)sizeof(line) - 2) {
+        length = sizeof(line) - 2;
+    }
+    line[length++] = '\n';
+    send(client, line, length, MSG_NOSIGNAL);
+}
+
+/**
+ * Returns the producer of the given index, or NULL if there is none.
+ */
+static Producer* findProducer(int index) {
+    Producer* producer = NULL;
+    sem_wait(&producersMutex);
+    if (index >= 0 && index < numProducers) {
+        producer = producers[index];
+    }
+    sem_post(&producersMutex);
+    return producer;
+}
+
+/**
+ * Lists the producers and the queues.
+ */
+static void replyStatus(int client) {
+    static const char* types[] = {"synthetic", "file", "replay"};
+    sem_wait(&producersMutex);
+    int numListed = numProducers;
+    Producer* snapshot[numListed > 0 ? numListed : 1];
+    memcpy(snapshot, producers, sizeof(Producer*) * numListed);
+    sem_post(&producersMutex);
+
+    for (int i = 0; i < numListed; i++) {
+        Producer* producer = snapshot[i];
+        int retired = __atomic_load_n(&producer->retired, __ATOMIC_ACQUIRE);
+        int count, size;
+        bufferOccupancy(producer->buffer, &count, &size);
+        reply(client, "PRODUCER %d id %d %s %s queue %d/%d", i, producer->producerID + 1,
+              types[producer->type], retired ? "retired" : "running", count, size);
+    }
+    int count, size;
+    bufferOccupancy(sharedBuffer, &count, &size);
+    reply(client, "OK SHARED %d/%d", count, size);
+}
+
+/**
+ * Executes one command line.
+ *
+ * @return 1 when the client closed the channel, 0 otherwise.
+ */
+static int execute(int client, char* line) {
+    char command[16], argument[4096];
+    int size;
+    if (sscanf(line, "%15s", command) != 1) {
+        return 0;
+    }
+
+    if (strcmp(command, "ADD") == 0) {
+        int numArticles;
+        if (sscanf(line, "%*s %d %d", &numArticles, &size) != 2 || numArticles < 0 || size <= 0) {
+            reply(client, "ERROR usage: ADD <articles> <queue size>");
+            return 0;
+        }
+        // the id continues the ids of the configuration file
+        int maxID = 0;
+        sem_wait(&producersMutex);
+        for (int i = 0; i < numProducers; i++) {
+            if (producers[i]->producerID + 1 > maxID) {
+                maxID = producers[i]->producerID + 1;
+            }
+        }
+        sem_post(&producersMutex);
+        char id[16], products[16], queueSize[16];
+        snprintf(id, sizeof(id), "%d", maxID + 1);
+        snprintf(products, sizeof(products), "%d", numArticles);
+        snprintf(queueSize, sizeof(queueSize), "%d", size);
+        Producer* producer = malloc(sizeof(Producer));
+        createProducer(producer, id, products, queueSize);
+        int index = startProducer(producer);
+        reply(client, "OK producer %d id %d", index, maxID + 1);
+    } else if (strcmp(command, "INGEST") == 0) {
+        if (sscanf(line, "%*s %4095s %d", argument, &size) != 2 || size <= 0) {
+            reply(client, "ERROR usage: INGEST <path> <queue size>");
+            return 0;
+        }
+        Producer* producer = malloc(sizeof(Producer));
+        sem_wait(&producersMutex);
+        int id = numProducers;
+        sem_post(&producersMutex);
+        createIngestProducer(producer, id, argument, size);
+        int index = startProducer(producer);
+        reply(client, "OK producer %d", index);
+    } else if (strcmp(command, "RESIZE") == 0) {
+        if (sscanf(line, "%*s %63s %d", argument, &size) != 2 || size <= 0) {
+            reply(client, "ERROR usage: RESIZE SHARED|<producer> <size>");
+            return 0;
+        }
+        BoundedBuffer* buffer = sharedBuffer;
+        if (strcmp(argument, "SHARED") != 0) {
+            Producer* producer = findProducer(atoi(argument));
+            if (producer == NULL || __atomic_load_n(&producer->retired, __ATOMIC_ACQUIRE)) {
+                reply(client, "ERROR no running producer %s", argument);
+                return 0;
+            }
+            buffer = producer->buffer;
+        }
+        int resized = resizeBuffer(buffer, size, RESIZE_TIMEOUT_MS);
+        if (resized == -2) {
+            reply(client, "ERROR busy");
+            return 0;
+        }
+        if (resized != 0) {
+            reply(client, "ERROR can't resize %s", argument);
+            return 0;
+        }
+        reply(client, "OK %s %d", argument, size);
+    } else if (strcmp(command, "STATUS") == 0) {
+        replyStatus(client);
+    } else if (strcmp(command, "CLOSE") == 0) {
+        __atomic_store_n(&control.open, 0, __ATOMIC_RELEASE);
+        reply(client, "OK closed");
+        return 1;
+    } else {
+        reply(client, "ERROR unknown command %s", command);
+    }
+    return 0;
+}
+
+/**
+ * The control thread: serves the clients one after the other until one of them closes the channel.
+ */
+static void* controlServer(void* arg) {
+    while (controlOpen()) {
+        int client = accept(control.fd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("control");
+            break;
+        }
+        FILE* input = fdopen(client, "r");
+        char* line = NULL;
+        size_t len = 0;
+        int closed = 0;
+        while (!closed && getline(&line, &len, input) != -1) {
+            closed = execute(client, line);
+        }
+        free(line);
+        // closes the client socket too
+        fclose(input);
+    }
+    return NULL;
+}
+
+/**
+ * Opens the control socket and starts serving it.
+ *
+ * @param path The path of the Unix socket, replaced if it exists.
+ * @return 0 on success, -1 if the socket can't be opened.
+ */
+int startControl(const char* path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Control socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    control.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (control.fd < 0 || bind(control.fd, (struct sockaddr*)&address, sizeof(address)) != 0
+        || listen(control.fd, 4) != 0) {
+        perror("control");
+        if (control.fd >= 0) {
+            close(control.fd);
+        }
+        control.fd = -1;
+        return -1;
+    }
+    control.path = strdup(path);
+    control.open = 1;
+    pthread_create(&control.thread, NULL, controlServer, NULL);
+    return 0;
+}
+
+/**
+ * Returns whether the control channel may still add producers.
+ */
+int controlOpen() {
+    return __atomic_load_n(&control.open, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Waits for the control thread and removes the socket. The channel must be closed already.
+ */
+void stopControl() {
+    if (control.fd < 0) {
+        return;
+    }
+    pthread_join(control.thread, NULL);
+    close(control.fd);
+    unlink(control.path);
+    free(control.path);
+    control.fd = -1;
+}
@@ -0,0 +1,27 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../globals.h"
+#include "../Config/Config.h"
+#include "../BoundedBuffer/BoundedBuffer.h"
+
+// how long a RESIZE that shrinks a queue waits for its consumer to make room
+#define RESIZE_TIMEOUT_MS 1000
+
+int startControl(const char* path);
+
+int controlOpen();
+
+void stopControl();
+
+#endif
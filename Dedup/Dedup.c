@@ -0,0 +1,157 @@
+#include "Dedup.h"
+
+/**
+ * Returns the current monotonic time in milliseconds.
+ */
+static long nowMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Hashes the content of an article (64-bit FNV-1a).
+ *
+ * @param text The text of the article.
+ * @return The hash, never 0.
+ */
+uint64_t hashArticle(const char* text) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char* c = (const unsigned char*)text; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    // 0 marks an empty slot
+    return hash != 0 ? hash : 1;
+}
+
+/**
+ * Finds the slot of a key in a shard's table: the slot holding it, or the empty slot where it belongs.
+ */
+static int findSlot(DedupShard* shard, uint64_t key) {
+    int slot = (int)(key & shard->tableMask);
+    while (shard->table[slot].key != 0 && shard->table[slot].key != key) {
+        slot = (slot + 1) & shard->tableMask;
+    }
+    return slot;
+}
+
+/**
+ * Removes the entry in a slot, shifting back the entries of its probe sequence (no tombstones).
+ */
+static void removeSlot(DedupShard* shard, int slot) {
+    int next = (slot + 1) & shard->tableMask;
+    while (shard->table[next].key != 0) {
+        int home = (int)(shard->table[next].key & shard->tableMask);
+        // move the entry back if its home isn't between the hole and its current slot
+        if (((next - home) & shard->tableMask) >= ((next - slot) & shard->tableMask)) {
+            shard->table[slot] = shard->table[next];
+            slot = next;
+        }
+        next = (next + 1) & shard->tableMask;
+    }
+    shard->table[slot].key = 0;
+}
+
+/**
+ * Evicts the oldest key of a shard (the table entry is only removed if it is the one the order ring
+ * recorded).
+ */
+static void evictOldest(DedupShard* shard) {
+    DedupEntry* oldest = &shard->order[shard->orderHead];
+    int slot = findSlot(shard, oldest->key);
+    if (shard->table[slot].key != 0 && shard->table[slot].stamp == oldest->stamp) {
+        removeSlot(shard, slot);
+    }
+    shard->orderHead = (shard->orderHead + 1) % shard->capacity;
+    shard->count--;
+}
+
+/**
+ * Creates a dedup set.
+ *
+ * @param capacity The maximal number of keys remembered, split among the shards.
+ * @param ttlMs    The time a key is remembered for, in milliseconds (0 to keep keys until evicted).
+ * @return a pointer to the dedup set.
+ */
+DedupSet* initDedupSet(int capacity, long ttlMs) {
+    DedupSet* set;
+    if (posix_memalign((void**)&set, CACHE_LINE_SIZE, sizeof(DedupSet)) != 0) {
+        return NULL;
+    }
+    set->ttlMs = ttlMs;
+    set->duplicates = 0;
+
+    int shardCapacity = (capacity + DEDUP_SHARDS - 1) / DEDUP_SHARDS;
+    // keep the load factor of the tables at most 1/2
+    int tableSize = 2;
+    while (tableSize < 2 * shardCapacity) {
+        tableSize *= 2;
+    }
+    for (int i = 0; i < DEDUP_SHARDS; i++) {
+        DedupShard* shard = &set->shards[i];
+        sem_init(&shard->mutex, 0, 1);
+        shard->table = calloc(tableSize, sizeof(DedupEntry));
+        shard->tableMask = tableSize - 1;
+        shard->order = malloc(sizeof(DedupEntry) * shardCapacity);
+        shard->orderHead = 0;
+        shard->count = 0;
+        shard->capacity = shardCapacity;
+    }
+    return set;
+}
+
+/**
+ * Checks whether an article with the same content was seen recently, and remembers it.
+ * Safe to call from several threads.
+ *
+ * @param set  Pointer to the dedup set.
+ * @param text The text of the article.
+ * @return 1 if the article is a duplicate, 0 otherwise.
+ */
+int dedupSeen(DedupSet* set, const char* text) {
+    uint64_t key = hashArticle(text);
+    DedupShard* shard = &set->shards[key >> 60];
+    long now = nowMs();
+
+    sem_wait(&shard->mutex);
+
+    // time based eviction of the oldest keys
+    while (set->ttlMs > 0 && shard->count > 0 && now - shard->order[shard->orderHead].stamp > set->ttlMs) {
+        evictOldest(shard);
+    }
+
+    int slot = findSlot(shard, key);
+    if (shard->table[slot].key == key) {
+        sem_post(&shard->mutex);
+        __atomic_add_fetch(&set->duplicates, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+
+    // count based eviction
+    if (shard->count == shard->capacity) {
+        evictOldest(shard);
+        slot = findSlot(shard, key);
+    }
+    shard->table[slot].key = key;
+    shard->table[slot].stamp = now;
+    shard->order[(shard->orderHead + shard->count) % shard->capacity] = shard->table[slot];
+    shard->count++;
+
+    sem_post(&shard->mutex);
+    return 0;
+}
+
+/**
+ * Frees a dedup set.
+ *
+ * @param set Pointer to the dedup set.
+ */
+void destroyDedupSet(DedupSet* set) {
+    for (int i = 0; i < DEDUP_SHARDS; i++) {
+        sem_destroy(&set->shards[i].mutex);
+        free(set->shards[i].table);
+        free(set->shards[i].order);
+    }
+    free(set);
+}
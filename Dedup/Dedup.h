@@ -0,0 +1,52 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../cacheline.h"
+
+// number of independently locked shards; a key's shard is picked by its top hash bits
+#define DEDUP_SHARDS 16
+
+// an entry of a shard's hash table (key 0 marks an empty slot) or of its insertion order ring
+typedef struct {
+    uint64_t key;
+    long stamp; // insertion time, in milliseconds
+} DedupEntry;
+
+/**
+ * A shard: a linear probing hash table of at most "capacity" keys, and a ring holding the keys in
+ * insertion order, which is what gets evicted first.
+ */
+typedef struct {
+    sem_t mutex;
+    DedupEntry* table;
+    int tableMask;
+    DedupEntry* order;
+    int orderHead;
+    int count;
+    int capacity;
+} CACHE_ALIGNED DedupShard;
+
+/**
+ * A concurrent set of article content hashes with bounded memory: every shard evicts its oldest key
+ * when it is full, and keys older than ttlMs (when positive) no longer count as seen.
+ */
+typedef struct {
+    DedupShard shards[DEDUP_SHARDS];
+    long ttlMs;
+    long duplicates;
+} DedupSet;
+
+uint64_t hashArticle(const char* text);
+
+DedupSet* initDedupSet(int capacity, long ttlMs);
+
+int dedupSeen(DedupSet* set, const char* text);
+
+void destroyDedupSet(DedupSet* set);
+
+#endif
@@ -1,4 +1,6 @@
 #include "Dispatcher.h"
+#include "../globals.h"
+#include "../Processes/Processes.h"
 
 /**
  * Extracts the message type from the message string and returns the corresponding message type number.
@@ -24,6 +26,60 @@ int getMessageType(const char* message) {
     }
 }
 
+/**
+ * Initializes the unbounded queues of the sorted articles, with the articles of a checkpoint, the
+ * admission policies and the memory accounting of the categories.
+ *
+ * @param queues The NUM_MESSAGE_TYPES queues, allocated cache-line aligned.
+ */
+void initCategoryQueues(UnboundedBuffer* queues) {
+    for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+        initUnboundedBuffer(&queues[i]);
+        accountUnboundedBuffer(&queues[i], memoryAccount(MEMORY_CATEGORIES));
+        // event loop co-editors wait for their queue on an eventfd
+        if (config.editConcurrency > 1 && enableNotify(&queues[i]) != 0) {
+            perror("eventfd");
+        }
+    }
+    // the articles queued when the previous run stopped come first, they were admitted already
+    restoreCheckpoint(queues, NUM_MESSAGE_TYPES);
+    // limit the categories that have an admission policy
+    for (int i = 0; i < config.numPolicies; i++) {
+        int messageType = getMessageType(config.policies[i].category);
+        if (messageType == -1) {
+            fprintf(stderr, "Unknown category in POLICY: %s\n", config.policies[i].category);
+            continue;
+        }
+        setAdmissionPolicy(&queues[messageType], &config.policies[i], messageType + 1);
+    }
+}
+
+/**
+ * Reports what the admission policies dropped and what was spilled to disk, and frees the queues of
+ * the sorted articles with the articles left in them. No thread may use them anymore.
+ *
+ * @param queues The NUM_MESSAGE_TYPES queues.
+ */
+void destroyCategoryQueues(UnboundedBuffer* queues) {
+    for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+        for (int lane = 0; lane < NUM_PRIORITIES; lane++) {
+            Spill* spill = &queues[i].lanes[lane].spill;
+            if (spill->spilled > 0) {
+                fprintf(stderr, "Category %d lane %d: spilled %ld articles, at most %ld on disk at once\n",
+                        i, lane, spill->spilled, spill->maxCount);
+                if (config.compress) {
+                    fprintf(stderr, "Category %d lane %d: compressed %ld spilled bytes to %ld\n",
+                            i, lane, spill->rawBytes, spill->storedBytes);
+                }
+            }
+        }
+        if (queues[i].dropped > 0) {
+            fprintf(stderr, "Category %d: dropped %ld articles by its admission policy\n", i, queues[i].dropped);
+        }
+        destroyUnboundedBuffer(&queues[i]);
+    }
+}
+
 /**
  * Initializes the Dispatcher structure and sets up the references to the producer queues and dispatcher queues.
  *
@@ -31,45 +87,260 @@ int getMessageType(const char* message) {
  */
 void initDispatcher(Dispatcher* dispatcher) {
     // connect between the dispatcher and the producer's queue.
-    dispatcher->producers = producers;
-    dispatcher->numProducers = numProducers;
+    // the producers are picked up by the dispatcher itself (see syncProducers)
+    dispatcher->producers = NULL;
+    dispatcher->buffers = NULL;
+    dispatcher->indices = NULL;
+    dispatcher->numProducers = 0;
+    dispatcher->numKnown = 0;
+    dispatcher->nextSeq = NULL;
+    initSelector(&dispatcher->selector);
+    dispatcher->bundles = NULL;
+    if (config.bundleSize > 1) {
+        dispatcher->bundles = malloc(sizeof(Bundle) * NUM_MESSAGE_TYPES);
+        for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+            dispatcher->bundles[i].articles = malloc(sizeof(Article*) * config.bundleSize);
+            dispatcher->bundles[i].count = 0;
+        }
+    }
+    dispatcher->dedup = config.dedupCapacity > 0 ? initDedupSet(config.dedupCapacity, config.dedupTtlMs) : NULL;
     // intialize the unbounded queues of the sorted articles.
+    // in the multi-process mode they live in the co-editors' process, and these are the rings to it
+    if (config.processes) {
+        for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+            initSharedUnboundedBuffer(&dispatcher->dispatcherQueues[i], categoryRing(i));
+        }
+    } else {
+        initCategoryQueues(dispatcher->dispatcherQueues);
+    }
+    // route every article to the category it names, and to the categories subscribed to a keyword it mentions
+    static const char* categoryNames[] = {"SPORTS", "NEWS", "WEATHER"};
+    dispatcher->routes = malloc(sizeof(Route) * (NUM_MESSAGE_TYPES + config.numSubscriptions));
+    dispatcher->numRoutes = 0;
+    dispatcher->fannedOut = 0;
     for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
-        initUnboundedBuffer(&dispatcher->dispatcherQueues[i]);
+        dispatcher->routes[dispatcher->numRoutes++] = (Route){categoryNames[i], i};
+    }
+    for (int i = 0; i < config.numSubscriptions; i++) {
+        int messageType = getMessageType(config.subscriptions[i].category);
+        if (messageType == -1) {
+            fprintf(stderr, "Unknown category in SUBSCRIBE: %s\n", config.subscriptions[i].category);
+            continue;
+        }
+        dispatcher->routes[dispatcher->numRoutes++] = (Route){config.subscriptions[i].keyword, messageType};
     }
 }
 
 /**
- * The dispatcher function continuously scans the producer queues using a Round Robin algorithm and sorts the received messages
- * based on their types into the corresponding dispatcher queues.
- * Once a "DONE" message is received from all producers, it sends a "DONE" message through each dispatcher queue.
+ * Adds the producers that joined the global array (at startup, or through the control channel)
+ * since the last call to the producers the dispatcher scans.
+ */
+static void syncProducers(Dispatcher* dispatcher) {
+    sem_wait(&producersMutex);
+    if (dispatcher->numKnown < numProducers) {
+        dispatcher->producers = realloc(dispatcher->producers, sizeof(Producer*) * numProducers);
+        dispatcher->buffers = realloc(dispatcher->buffers, sizeof(BoundedBuffer*) * numProducers);
+        dispatcher->indices = realloc(dispatcher->indices, sizeof(int) * numProducers);
+        dispatcher->nextSeq = realloc(dispatcher->nextSeq, sizeof(int) * numProducers);
+        for (int i = dispatcher->numKnown; i < numProducers; i++) {
+            dispatcher->producers[dispatcher->numProducers] = producers[i];
+            dispatcher->buffers[dispatcher->numProducers] = producers[i]->buffer;
+            watchBuffer(producers[i]->buffer, &dispatcher->selector);
+            dispatcher->indices[dispatcher->numProducers] = i;
+            dispatcher->numProducers++;
+            // the articles restored from a checkpoint took the first sequence numbers
+            dispatcher->nextSeq[i] = producers[i]->resumedSeq;
+        }
+        dispatcher->numKnown = numProducers;
+    }
+    sem_post(&producersMutex);
+}
+
+/**
+ * Stops scanning a producer whose DONE went through.
+ */
+static void retireProducer(Dispatcher* dispatcher, int i) {
+    __atomic_store_n(&dispatcher->producers[i]->retired, 1, __ATOMIC_RELEASE);
+    dispatcher->numProducers--;
+    dispatcher->producers[i] = dispatcher->producers[dispatcher->numProducers];
+    dispatcher->buffers[i] = dispatcher->buffers[dispatcher->numProducers];
+    dispatcher->indices[i] = dispatcher->indices[dispatcher->numProducers];
+}
+
+#ifdef STATIC_PIPELINE
+// the routing table of the configuration the build was generated from (see Static/StaticConfig.awk)
+static const Route staticRoutes[] = STATIC_ROUTES;
+#define NUM_STATIC_ROUTES ((int)(sizeof(staticRoutes) / sizeof(staticRoutes[0])))
+#endif
+
+/**
+ * Finds the categories an article goes to, in the routing table.
+ * The specialized build routes with its constant table instead, a loop the compiler unrolls.
+ *
+ * @param text       The text of the article.
+ * @param categories Set to the categories, each one once.
+ * @return The number of categories, 0 if the article mentions no known keyword.
+ */
+static int routeArticle(Dispatcher* dispatcher, const char* text, int categories[]) {
+    int matched[NUM_MESSAGE_TYPES] = {0};
+    int numCategories = 0;
+#ifdef STATIC_PIPELINE
+    const Route* routes = staticRoutes;
+    const int numRoutes = NUM_STATIC_ROUTES;
+#pragma GCC unroll 16
+#else
+    const Route* routes = dispatcher->routes;
+    int numRoutes = dispatcher->numRoutes;
+#endif
+    for (int i = 0; i < numRoutes; i++) {
+        const Route* route = &routes[i];
+        if (!matched[route->category] && strstr(text, route->keyword) != NULL) {
+            matched[route->category] = 1;
+            categories[numCategories++] = route->category;
+        }
+    }
+    return numCategories;
+}
+
+/**
+ * Forwards the bundles that are full, have waited for BUNDLE's timeout, or all of them, to their
+ * category queues in one piece.
+ *
+ * @return The milliseconds until the timeout of the oldest bundle left, -1 if none is left.
+ */
+static long flushBundles(Dispatcher* dispatcher, int all) {
+    if (dispatcher->bundles == NULL) {
+        return -1;
+    }
+    long nowNs = monotonicNs();
+    long nextMs = -1;
+    for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+        Bundle* bundle = &dispatcher->bundles[i];
+        if (bundle->count == 0) {
+            continue;
+        }
+        long leftNs = bundle->startNs + config.bundleTimeoutMs * 1000000L - nowNs;
+        if (all || bundle->count == config.bundleSize || leftNs <= 0) {
+            insertUnBoundedBatch(&dispatcher->dispatcherQueues[i], bundle->articles, bundle->count);
+            bundle->count = 0;
+        } else {
+            long leftMs = (leftNs + 999999) / 1000000;
+            if (nextMs < 0 || leftMs < nextMs) {
+                nextMs = leftMs;
+            }
+        }
+    }
+    return nextMs;
+}
+
+/**
+ * Forwards an article to its category queue, or adds it to the category's bundle when bundling.
+ */
+static void forward(Dispatcher* dispatcher, int messageType, Article* article) {
+    if (dispatcher->bundles == NULL) {
+        insertUnBounded(&dispatcher->dispatcherQueues[messageType], article);
+        return;
+    }
+    Bundle* bundle = &dispatcher->bundles[messageType];
+    if (bundle->count == 0) {
+        bundle->startNs = monotonicNs();
+    }
+    bundle->articles[bundle->count++] = article;
+    if (bundle->count == config.bundleSize) {
+        flushBundles(dispatcher, 0);
+    }
+}
+
+/**
+ * The dispatcher function waits on all the producer queues at once, takes the articles from them using a Round Robin
+ * algorithm (see selectBounded) and sorts them based on their types into the corresponding dispatcher queues.
+ * An article that several categories are routed to (see routeArticle) goes to each of their queues, as
+ * copies sharing its text.
+ * With BUNDLE, the articles of a category are forwarded in bundles (see flushBundles).
+ * A producer is retired once its "DONE" message is received. When all the producers are retired (and the
+ * control channel, if any, is closed), it sends a "DONE" message through each dispatcher queue.
  *
  * @param dispatcher    Pointer to the Dispatcher structure.
  */
 void* dispatche(void* arg) {
 Dispatcher* dispatcher = (Dispatcher*)arg;
-    int doneCounter = 0;  // Counter to keep track of "DONE" messages received from Producers
-    while (doneCounter < numProducers) {
-        for (int i = 0; i < numProducers; i++) {
-            if(dispatcher->producers[i]->buffer->count > 0) {
-                char* message = removeBounded(dispatcher->producers[i]->buffer);
-
-                if (strcmp(message, "DONE") == 0) {
-                    doneCounter++;
-                } else {
-                    int messageType = getMessageType(message);
-                    // check for a valid article type
-                    if (messageType == -1){continue;}
-                    insertUnBounded(&dispatcher->dispatcherQueues[messageType], message);
-                    
-                }
+    TRACE_THREAD("dispatcher", 0);
+    while (1) {
+        long bundleMs = flushBundles(dispatcher, 0);
+        syncProducers(dispatcher);
+        if (dispatcher->numProducers == 0) {
+            // a run stopped for a checkpoint doesn't wait for the control channel to close
+            if (!controlOpen() || checkpointRequested()) {
+                break;
             }
-//            free(message);
+            // wait for the control channel to add a producer
+            usleep(1000);
+            continue;
+        }
+        // while the control channel is open, wake up now and then to pick up new producers, and
+        // wake up in time for the timeout of the oldest bundle
+        long timeoutMs = controlOpen() ? SYNC_INTERVAL_MS : -1;
+        if (bundleMs >= 0 && (timeoutMs < 0 || bundleMs < timeoutMs)) {
+            timeoutMs = bundleMs;
         }
+        int i;
+        Article* article = selectBounded(&dispatcher->selector, dispatcher->buffers, dispatcher->numProducers,
+                                         timeoutMs, &i);
+        if (article == NULL) {
+            continue;
+        }
+        TRACE_BEGIN(dispatch);
+        if (isDone(article)) {
+            retireProducer(dispatcher, i);
+            freeArticle(article);
+            continue;
+        }
+        int categories[NUM_MESSAGE_TYPES];
+        int numCategories = routeArticle(dispatcher, article->text, categories);
+        // check for a valid article type
+        if (numCategories == 0){
+            journalDrop(article);
+            auditDropped(article);
+            freeArticle(article);
+            continue;
+        }
+        // drop resubmitted stories before they cost editing time
+        if (dispatcher->dedup != NULL && dedupSeen(dispatcher->dedup, article->text)) {
+            journalDrop(article);
+            auditDropped(article);
+            freeArticle(article);
+            continue;
+        }
+        // make the copies before the article is forwarded (and may be freed); each one is a delivery
+        // of its own for the audit
+        Article* copies[NUM_MESSAGE_TYPES];
+        copies[0] = article;
+        for (int k = 1; k < numCategories; k++) {
+            copies[k] = shareArticle(article);
+            auditProduced(copies[k]);
+        }
+        if (numCategories > 1) {
+            dispatcher->fannedOut++;
+        }
+        for (int k = 0; k < numCategories; k++) {
+            // number the forwarded articles of each producer, for the ordered output mode
+            copies[k]->seq = dispatcher->nextSeq[dispatcher->indices[i]]++;
+            recordStage(copies[k], STAGE_DISPATCHED);
+            forward(dispatcher, categories[k], copies[k]);
+        }
+        TRACE_END(dispatch, "dispatche");
+        jitter();
     }
-    // Send "DONE" message through each Dispatcher queue
+    // Send the last bundles, and a "DONE" message through each Dispatcher queue
+    flushBundles(dispatcher, 1);
     for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
-        insertUnBounded(&dispatcher->dispatcherQueues[i], "DONE");
+        insertUnBounded(&dispatcher->dispatcherQueues[i], newDone());
+    }
+    if (dispatcher->fannedOut > 0) {
+        fprintf(stderr, "Dispatcher: routed %ld articles to several categories\n", dispatcher->fannedOut);
+    }
+    if (dispatcher->dedup != NULL) {
+        fprintf(stderr, "Dispatcher: dropped %ld duplicate articles\n", dispatcher->dedup->duplicates);
     }
     return NULL;
 }
\ No newline at end of file
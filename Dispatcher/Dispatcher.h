@@ -8,15 +8,47 @@
 #include "../UnBoundedBuffer/UnBoundedBuffer.h"
 #include "../BoundedBuffer/BoundedBuffer.h"
 #include "../Producer/Producer.h"
+#include "../Dedup/Dedup.h"
+#include "../Control/Control.h"
 
+// How often the dispatcher looks for producers added through the control channel while it is open.
+#define SYNC_INTERVAL_MS 10
+
+// Articles of a category that the dispatcher holds back to forward them together (see BUNDLE).
+typedef struct {
+    Article** articles;
+    int count;
+    long startNs; // when the first of them arrived
+} Bundle;
+
+// An entry of the routing table: the articles that mention the keyword go to the category's queue.
 typedef struct {
-    Producer** producers;
-    int numProducers;
+    const char* keyword;
+    int category;
+} Route;
+
+typedef struct {
+    Producer** producers; // the producers that are still running, in scan order
+    BoundedBuffer** buffers; // their queues
+    int* indices;         // their indices in the global producers array
+    int numProducers;     // the number of running producers
+    int numKnown;         // the producers of the global array seen so far
     UnboundedBuffer* dispatcherQueues;
+    int* nextSeq; // the sequence number of the next article forwarded from each producer (by index)
+    DedupSet* dedup; // recently seen articles, NULL when deduplication is disabled
+    Selector selector; // watches the queues of the producers
+    Bundle* bundles;   // the bundle being filled for each category, NULL when bundling is disabled
+    Route* routes;     // the category names, then the SUBSCRIBE options
+    int numRoutes;
+    long fannedOut;    // articles routed to more than one category
 } Dispatcher;
 
 int getMessageType(const char* message);
 
+void initCategoryQueues(UnboundedBuffer* queues);
+
+void destroyCategoryQueues(UnboundedBuffer* queues);
+
 void initDispatcher(Dispatcher* dispatcher);
 
 void* dispatche(void* arg);
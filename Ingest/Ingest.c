@@ -0,0 +1,127 @@
+#include "Ingest.h"
+
+// size of the reads when the input can't be mapped (stdin, pipes)
+#define INGEST_READ_SIZE (1 << 20)
+
+/**
+ * Turns a line of the input into an article and inserts it into the producer's buffer.
+ * A line starting with '!' is breaking news: it takes the high priority lane (without the '!').
+ * Empty lines are skipped, and so are the articles sent before the checkpoint the producer resumes from.
+ */
+static void ingestLine(Producer* producer, int index, const char* line, size_t length) {
+    if (length > 0 && line[length - 1] == '\r') {
+        length--;
+    }
+    int priority = PRIORITY_NORMAL;
+    if (length > 0 && line[0] == '!') {
+        priority = PRIORITY_HIGH;
+        line++;
+        length--;
+    }
+    if (length == 0 || producer->progress++ < producer->resumeAt) {
+        return;
+    }
+    Article* article = newArticleFromBytes(line, length, priority);
+    article->producer = index;
+    journalAccept(article);
+    auditProduced(article);
+    recordArrival(article);
+    insertBounded(producer->buffer, article);
+    jitter();
+}
+
+/**
+ * Splits a block of the input on newlines, ingesting every complete line, until the run is stopped
+ * for a checkpoint.
+ *
+ * @return The number of bytes consumed (the start of an incomplete last line).
+ */
+static size_t ingestLines(Producer* producer, int index, const char* data, size_t size) {
+    size_t start = 0;
+    const char* newline;
+    while (!checkpointRequested() && (newline = memchr(data + start, '\n', size - start)) != NULL) {
+        size_t end = newline - data;
+        ingestLine(producer, index, data + start, end - start);
+        start = end + 1;
+    }
+    return start;
+}
+
+/**
+ * Ingests a regular file through a read-only mapping, without copying it.
+ */
+static void ingestMapped(Producer* producer, int index, int fd, size_t size) {
+    char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+    size_t consumed = ingestLines(producer, index, data, size);
+    // a last line without a newline
+    if (consumed < size && !checkpointRequested()) {
+        ingestLine(producer, index, data + consumed, size - consumed);
+    }
+    munmap(data, size);
+}
+
+/**
+ * Ingests a stream (stdin, a pipe) with large reads, carrying an incomplete last line over to
+ * the next read.
+ */
+static void ingestStream(Producer* producer, int index, int fd) {
+    size_t capacity = INGEST_READ_SIZE;
+    char* data = malloc(capacity);
+    size_t size = 0;
+    ssize_t bytesRead;
+
+    while (1) {
+        // a line longer than the buffer
+        if (size == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+        bytesRead = checkpointRequested() ? 0 : read(fd, data + size, capacity - size);
+        if (bytesRead <= 0) {
+            break;
+        }
+        size += bytesRead;
+        size_t consumed = ingestLines(producer, index, data, size);
+        memmove(data, data + consumed, size - consumed);
+        size -= consumed;
+    }
+    if (bytesRead < 0) {
+        perror("read");
+    }
+    if (size > 0 && !checkpointRequested()) {
+        ingestLine(producer, index, data, size);
+    }
+    free(data);
+}
+
+/**
+ * Streams the articles of a file producer's input into its bounded buffer, one article per line,
+ * followed by a "DONE" message. Regular files are mapped; stdin and pipes are read in large blocks.
+ * Lines are split in place, the only copy of an article is the one the pipeline owns.
+ *
+ * @param producer The producer, of type PRODUCER_FILE.
+ * @param index    The index of the producer in the producers array.
+ */
+void ingestFile(Producer* producer, int index) {
+    int fd = strcmp(producer->path, "-") == 0 ? STDIN_FILENO : open(producer->path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening input file %s.\n", producer->path);
+    } else {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            ingestMapped(producer, index, fd, st.st_size);
+        } else {
+            ingestStream(producer, index, fd);
+        }
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+    }
+
+    insertBounded(producer->buffer, newDone());
+}
@@ -0,0 +1,16 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../Producer/Producer.h"
+
+void ingestFile(Producer* producer, int index);
+
+#endif
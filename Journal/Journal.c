@@ -0,0 +1,324 @@
+#include "Journal.h"
+
+/**
+ * The journal is a single append-only file. Threads append records to an in-memory batch, and a
+ * writer thread commits the batch every commit interval (or as soon as it grows past
+ * JOURNAL_FLUSH_THRESHOLD) with a single write and fdatasync, so the cost of durability is shared by
+ * all the records of the batch.
+ */
+typedef struct {
+    int fd;
+    long commitIntervalMs;
+    sem_t mutex;         // protects the batch
+    sem_t flushRequest;  // wakes the writer up before the interval is over
+    char* batch;
+    size_t batchSize;
+    size_t batchCapacity;
+    int closing;
+    uint64_t nextId;
+    long records;
+    long commits;
+    pthread_t writerThread;
+} Journal;
+
+static Journal journal = {.fd = -1, .nextId = 1};
+
+/**
+ * Computes the checksum of a record (32-bit FNV-1a over the header after the checksum field is
+ * cleared, and the text).
+ */
+static uint32_t recordChecksum(const JournalRecord* record, const char* text) {
+    JournalRecord header = *record;
+    header.checksum = 0;
+    uint32_t hash = 2166136261u;
+    const unsigned char* bytes = (const unsigned char*)&header;
+    for (size_t i = 0; i < sizeof(header); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    for (uint32_t i = 0; i < record->length; i++) {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Writes the whole buffer, retrying on short writes.
+ */
+static int writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        size -= written;
+    }
+    return 0;
+}
+
+/**
+ * Commits the current batch: swaps it out under the mutex, then writes and syncs it outside of it,
+ * so appending threads never wait for the disk.
+ */
+static void commitBatch(char** spare, size_t* spareCapacity) {
+    sem_wait(&journal.mutex);
+    char* batch = journal.batch;
+    size_t batchCapacity = journal.batchCapacity;
+    size_t size = journal.batchSize;
+    journal.batch = *spare;
+    journal.batchCapacity = *spareCapacity;
+    journal.batchSize = 0;
+    *spare = batch;
+    *spareCapacity = batchCapacity;
+    sem_post(&journal.mutex);
+
+    if (size == 0) {
+        return;
+    }
+    if (writeAll(journal.fd, batch, size) != 0 || fdatasync(journal.fd) != 0) {
+        perror("journal");
+    }
+    journal.commits++;
+}
+
+/**
+ * The writer thread: group commits the batch every commit interval, or when it is asked to.
+ */
+static void* journalWriter(void* arg) {
+    char* spare = malloc(JOURNAL_FLUSH_THRESHOLD);
+    size_t spareCapacity = JOURNAL_FLUSH_THRESHOLD;
+    while (1) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (journal.commitIntervalMs % 1000) * 1000000L;
+        deadline.tv_sec += journal.commitIntervalMs / 1000 + deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        sem_timedwait(&journal.flushRequest, &deadline);
+
+        int closing = __atomic_load_n(&journal.closing, __ATOMIC_ACQUIRE);
+        commitBatch(&spare, &spareCapacity);
+        if (closing) {
+            break;
+        }
+    }
+    free(spare);
+    return NULL;
+}
+
+/**
+ * Appends a record to the current batch.
+ */
+static void appendRecord(char kind, int priority, uint64_t id, const char* text, uint32_t length) {
+    JournalRecord record = {.kind = kind, .priority = priority, .length = length, .id = id};
+    record.checksum = recordChecksum(&record, text);
+    size_t size = sizeof(record) + length;
+
+    sem_wait(&journal.mutex);
+    if (journal.batchSize + size > journal.batchCapacity) {
+        while (journal.batchSize + size > journal.batchCapacity) {
+            journal.batchCapacity *= 2;
+        }
+        journal.batch = realloc(journal.batch, journal.batchCapacity);
+    }
+    memcpy(journal.batch + journal.batchSize, &record, sizeof(record));
+    memcpy(journal.batch + journal.batchSize + sizeof(record), text, length);
+    journal.batchSize += size;
+    journal.records++;
+    int full = journal.batchSize >= JOURNAL_FLUSH_THRESHOLD;
+    sem_post(&journal.mutex);
+
+    if (full) {
+        sem_post(&journal.flushRequest);
+    }
+}
+
+/**
+ * Opens the journal for appending and starts its writer thread.
+ *
+ * @param path             The journal file.
+ * @param commitIntervalMs The longest time a record waits for its group commit.
+ * @return 0 on success, -1 if the journal can't be opened.
+ */
+int openJournal(const char* path, long commitIntervalMs) {
+    journal.fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (journal.fd < 0) {
+        fprintf(stderr, "Error opening journal %s.\n", path);
+        return -1;
+    }
+    journal.commitIntervalMs = commitIntervalMs > 0 ? commitIntervalMs : 1;
+    journal.batchCapacity = JOURNAL_FLUSH_THRESHOLD;
+    journal.batch = malloc(journal.batchCapacity);
+    journal.batchSize = 0;
+    journal.closing = 0;
+    journal.records = 0;
+    journal.commits = 0;
+    sem_init(&journal.mutex, 0, 1);
+    sem_init(&journal.flushRequest, 0, 0);
+    pthread_create(&journal.writerThread, NULL, journalWriter, NULL);
+    return 0;
+}
+
+/**
+ * Records that an article entered the system, and gives it its journal id.
+ * Articles replayed by a recovery already have an id, and were accepted before.
+ *
+ * @param article The accepted article.
+ */
+void journalAccept(Article* article) {
+    if (journal.fd < 0 || article->id != 0) {
+        return;
+    }
+    article->id = __atomic_fetch_add(&journal.nextId, 1, __ATOMIC_RELAXED);
+    appendRecord(JOURNAL_ACCEPTED, article->priority, article->id, article->text, strlen(article->text));
+}
+
+/**
+ * Records that an article was displayed.
+ *
+ * @param article The published article.
+ */
+void journalPublish(const Article* article) {
+    if (journal.fd >= 0 && article->id != 0) {
+        appendRecord(JOURNAL_PUBLISHED, 0, article->id, "", 0);
+    }
+}
+
+/**
+ * Records that an article was dropped on purpose (so a recovery doesn't replay it).
+ *
+ * @param article The dropped article.
+ */
+void journalDrop(const Article* article) {
+    if (journal.fd >= 0 && article->id != 0) {
+        appendRecord(JOURNAL_DROPPED, 0, article->id, "", 0);
+    }
+}
+
+/**
+ * Commits the last batch, stops the writer thread and closes the journal.
+ */
+void closeJournal() {
+    if (journal.fd < 0) {
+        return;
+    }
+    __atomic_store_n(&journal.closing, 1, __ATOMIC_RELEASE);
+    sem_post(&journal.flushRequest);
+    pthread_join(journal.writerThread, NULL);
+    fprintf(stderr, "Journal: %ld records in %ld group commits\n", journal.records, journal.commits);
+
+    close(journal.fd);
+    journal.fd = -1;
+    free(journal.batch);
+    sem_destroy(&journal.mutex);
+    sem_destroy(&journal.flushRequest);
+}
+
+static int compareIds(const void* a, const void* b) {
+    uint64_t first = *(const uint64_t*)a, second = *(const uint64_t*)b;
+    return first < second ? -1 : first > second;
+}
+
+static int compareArticleIds(const void* a, const void* b) {
+    return compareIds(&(*(Article* const*)a)->id, &(*(Article* const*)b)->id);
+}
+
+/**
+ * Reads a journal left by a previous run and returns the articles that were accepted but neither
+ * published nor dropped, in the order they were accepted. A torn record at the end (a crash in the
+ * middle of a write) ends the scan. The journal is then compacted to hold only these articles,
+ * and new ids continue after the highest one found.
+ *
+ * @param path    The journal file.
+ * @param pending Set to a malloc'd array of the unpublished articles.
+ * @return The number of unpublished articles, or -1 if the journal can't be read.
+ */
+int recoverJournal(const char* path, Article*** pending) {
+    *pending = NULL;
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        // nothing to recover
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    int count = 0, capacity = 64;
+    Article** articles = malloc(sizeof(Article*) * capacity);
+    int numResolved = 0, resolvedCapacity = 64;
+    uint64_t* resolved = malloc(sizeof(uint64_t) * resolvedCapacity);
+    size_t textCapacity = 256;
+    char* text = malloc(textCapacity);
+    JournalRecord record;
+
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.length + 1 > textCapacity) {
+            textCapacity = record.length + 1;
+            text = realloc(text, textCapacity);
+        }
+        if (fread(text, 1, record.length, file) != record.length || recordChecksum(&record, text) != record.checksum) {
+            fprintf(stderr, "Journal: ignoring a torn record at the end of %s\n", path);
+            break;
+        }
+        if (record.id >= journal.nextId) {
+            journal.nextId = record.id + 1;
+        }
+
+        if (record.kind == JOURNAL_ACCEPTED) {
+            if (count == capacity) {
+                capacity *= 2;
+                articles = realloc(articles, sizeof(Article*) * capacity);
+            }
+            Article* article = newArticleFromBytes(text, record.length, record.priority);
+            article->id = record.id;
+            articles[count++] = article;
+        } else {
+            if (numResolved == resolvedCapacity) {
+                resolvedCapacity *= 2;
+                resolved = realloc(resolved, sizeof(uint64_t) * resolvedCapacity);
+            }
+            resolved[numResolved++] = record.id;
+        }
+    }
+    fclose(file);
+    free(text);
+
+    // threads take ids before appending, so records are only roughly in id order: sort both lists
+    // and keep the accepted articles that were neither published nor dropped
+    qsort(articles, count, sizeof(Article*), compareArticleIds);
+    qsort(resolved, numResolved, sizeof(uint64_t), compareIds);
+    int unpublished = 0;
+    for (int i = 0, r = 0; i < count; i++) {
+        while (r < numResolved && resolved[r] < articles[i]->id) {
+            r++;
+        }
+        if (r < numResolved && resolved[r] == articles[i]->id) {
+            freeArticle(articles[i]);
+        } else {
+            articles[unpublished++] = articles[i];
+        }
+    }
+    free(resolved);
+
+    // compact the journal: rewrite it with the pending articles only, and swap it in atomically
+    char tempPath[4096];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        int failed = 0;
+        for (int i = 0; i < unpublished && !failed; i++) {
+            JournalRecord accepted = {.kind = JOURNAL_ACCEPTED, .priority = articles[i]->priority,
+                                      .length = strlen(articles[i]->text), .id = articles[i]->id};
+            accepted.checksum = recordChecksum(&accepted, articles[i]->text);
+            failed = writeAll(fd, (const char*)&accepted, sizeof(accepted)) != 0
+                     || writeAll(fd, articles[i]->text, accepted.length) != 0;
+        }
+        if (!failed && fsync(fd) == 0) {
+            rename(tempPath, path);
+        }
+        close(fd);
+    }
+
+    *pending = articles;
+    return unpublished;
+}
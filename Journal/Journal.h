@@ -0,0 +1,52 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "../Article/Article.h"
+
+// record kinds
+#define JOURNAL_ACCEPTED 'A'
+#define JOURNAL_PUBLISHED 'P'
+#define JOURNAL_DROPPED 'D'
+
+// the writer is woken up early once this many bytes are waiting
+#define JOURNAL_FLUSH_THRESHOLD (64 * 1024)
+
+/**
+ * The header of a journal record. An accepted record is followed by the article's text;
+ * published and dropped records only carry the article id.
+ */
+typedef struct {
+    uint8_t kind;
+    uint8_t priority;
+    uint16_t reserved;
+    uint32_t length;   // length of the text following the header
+    uint64_t id;
+    uint32_t checksum; // over the rest of the header and the text, detects a torn last record
+    uint32_t padding;
+} JournalRecord;
+
+int openJournal(const char* path, long commitIntervalMs);
+
+void journalAccept(Article* article);
+
+void journalPublish(const Article* article);
+
+void journalDrop(const Article* article);
+
+void closeJournal();
+
+int recoverJournal(const char* path, Article*** pending);
+
+#endif
@@ -0,0 +1,217 @@
+#include "LoadGenerator.h"
+
+// the time the producers started, every schedule and ramp step counts from it
+static long loadStartNs;
+// written by the screen manager thread only
+static LatencyHistogram totalLatency;
+static LatencyHistogram stepLatency[MAX_RAMP_STEPS];
+
+/**
+ * Returns the current monotonic time in nanoseconds.
+ */
+long monotonicNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/**
+ * Marks the start of the load, before the producer threads are created.
+ */
+void startLoad() {
+    loadStartNs = monotonicNs();
+}
+
+/**
+ * Returns the time the load started, in monotonic nanoseconds.
+ */
+long loadStartTime() {
+    return loadStartNs;
+}
+
+/**
+ * Sleeps until a given time (in monotonic nanoseconds); returns right away if it passed.
+ */
+static void sleepUntil(long ns) {
+    struct timespec due = {ns / 1000000000L, ns % 1000000000L};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR) {
+    }
+}
+
+/**
+ * Waits until an article of a replayed schedule is due.
+ *
+ * @param offsetNs When the article is due, since the start of the load.
+ * @return The intended send time of the article, in monotonic nanoseconds.
+ */
+long arriveAt(long offsetNs) {
+    long intended = loadStartNs + offsetNs;
+    sleepUntil(intended);
+    return intended;
+}
+
+/**
+ * Returns the ramp step a time belongs to (always 0 outside of the ramp mode).
+ */
+static int rampStep(long ns) {
+    if (config.rampStepMs <= 0) {
+        return 0;
+    }
+    long step = (ns - loadStartNs) / (config.rampStepMs * 1000000L);
+    return step < MAX_RAMP_STEPS ? (int)step : MAX_RAMP_STEPS - 1;
+}
+
+/**
+ * Returns the total configured rate, in articles per second, during a ramp step.
+ */
+static double rampRate(int step) {
+    // a ramp without a starting rate starts at its first step
+    if (config.rate <= 0) {
+        return (step + 1) * config.rampRate;
+    }
+    return config.rate + step * config.rampRate;
+}
+
+/**
+ * Initializes the arrival schedule of a rate-controlled producer.
+ *
+ * @param schedule     Pointer to the ArrivalSchedule to be initialized.
+ * @param numProducers The number of producers sharing the configured rate.
+ * @param seed         Seed of the random arrivals.
+ */
+void initSchedule(ArrivalSchedule* schedule, int numProducers, unsigned int seed) {
+    schedule->nextNs = loadStartNs;
+    schedule->numProducers = numProducers > 0 ? numProducers : 1;
+    schedule->burstLeft = 0;
+    schedule->seed = seed;
+}
+
+/**
+ * Waits until the next article of a schedule is due, and advances the schedule by an
+ * inter-arrival time drawn from the configured distribution.
+ *
+ * @param schedule Pointer to the ArrivalSchedule.
+ * @return The intended send time of the article, in monotonic nanoseconds.
+ */
+long nextArrival(ArrivalSchedule* schedule) {
+    long intended = schedule->nextNs;
+
+    // sleep until the article is due; a producer running late sends right away
+    sleepUntil(intended);
+
+    double interval = 1e9 * schedule->numProducers / rampRate(rampStep(intended));
+    switch (config.arrival) {
+        case ARRIVAL_POISSON:
+            // exponentially distributed gaps
+            interval *= -log(1.0 - (double)rand_r(&schedule->seed) / ((double)RAND_MAX + 1));
+            break;
+        case ARRIVAL_BURSTY:
+            if (schedule->burstLeft > 0) {
+                schedule->burstLeft--;
+                interval = 0;
+            } else {
+                schedule->burstLeft = BURST_SIZE - 1;
+                interval *= BURST_SIZE;
+            }
+            break;
+        default:
+            break;
+    }
+    schedule->nextNs = intended + (long)interval;
+    return intended;
+}
+
+/**
+ * Records a value in a latency histogram.
+ */
+static void recordValue(LatencyHistogram* histogram, long ns) {
+    long us = ns > 0 ? ns / 1000 : 0;
+    int bucket;
+    if (us < 8) {
+        bucket = (int)us;
+    } else {
+        int msb = 63 - __builtin_clzl(us);
+        bucket = (msb - 2) * 8 + (int)((us >> (msb - 3)) & 7);
+    }
+    if (bucket >= LATENCY_BUCKETS) {
+        bucket = LATENCY_BUCKETS - 1;
+    }
+    histogram->counts[bucket]++;
+    histogram->total++;
+    if (ns > histogram->maxNs) {
+        histogram->maxNs = ns;
+    }
+}
+
+/**
+ * Returns the lowest value (in microseconds) of a histogram bucket.
+ */
+static long bucketValue(int bucket) {
+    if (bucket < 8) {
+        return bucket;
+    }
+    int msb = bucket / 8 + 2;
+    return (8L + bucket % 8) << (msb - 3);
+}
+
+/**
+ * Returns a percentile of a latency histogram, in milliseconds.
+ */
+static double percentileMs(const LatencyHistogram* histogram, double percentile) {
+    long rank = (long)ceil(histogram->total * percentile / 100.0);
+    long seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += histogram->counts[bucket];
+        if (seen >= rank && seen > 0) {
+            return bucketValue(bucket) / 1000.0;
+        }
+    }
+    return histogram->maxNs / 1e6;
+}
+
+/**
+ * Records the latency of a displayed article, from its intended send time.
+ * Called by the screen manager; articles of producers without a rate are ignored.
+ *
+ * @param article The displayed article.
+ */
+void recordLatency(const Article* article) {
+    if (article->intendedNs == 0) {
+        return;
+    }
+    long latency = monotonicNs() - article->intendedNs;
+    recordValue(&totalLatency, latency);
+    recordValue(&stepLatency[rampStep(article->intendedNs)], latency);
+}
+
+/**
+ * Prints the latency percentiles and, in the ramp mode, the latency of every rate step and the
+ * highest rate whose 99th percentile met the SLO.
+ *
+ * @param out The stream to print to.
+ */
+void printLoadReport(FILE* out) {
+    if (totalLatency.total == 0) {
+        return;
+    }
+    fprintf(out, "Latency from intended send time: articles %ld, p50 %.1fms, p90 %.1fms, p99 %.1fms, "
+                 "p99.9 %.1fms, max %.1fms\n",
+            totalLatency.total, percentileMs(&totalLatency, 50), percentileMs(&totalLatency, 90),
+            percentileMs(&totalLatency, 99), percentileMs(&totalLatency, 99.9), totalLatency.maxNs / 1e6);
+
+    if (config.rampStepMs <= 0) {
+        return;
+    }
+    double sustainable = 0;
+    for (int step = 0; step < MAX_RAMP_STEPS && stepLatency[step].total > 0; step++) {
+        double p99 = percentileMs(&stepLatency[step], 99);
+        int withinSlo = p99 <= config.rampSloMs;
+        fprintf(out, "Ramp step %d: rate %.1f/s, articles %ld, p99 %.1fms%s\n", step, rampRate(step),
+                stepLatency[step].total, p99, withinSlo ? "" : " (over SLO)");
+        if (!withinSlo) {
+            break;
+        }
+        sustainable = rampRate(step);
+    }
+    fprintf(out, "Max sustainable rate: %.1f articles/s (p99 <= %ldms)\n", sustainable, config.rampSloMs);
+}
@@ -0,0 +1,54 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+
+#include "../Article/Article.h"
+#include "../Config/Config.h"
+
+// articles sent back to back by a bursty producer, before a proportionally longer gap
+#define BURST_SIZE 10
+// the ramp mode keeps latency statistics for up to this many rate steps
+#define MAX_RAMP_STEPS 64
+// log-linear buckets: 8 per power of two of microseconds
+#define LATENCY_BUCKETS (64 * 8)
+
+/**
+ * The open-loop arrival schedule of one rate-controlled producer. Articles are due at their
+ * intended send time regardless of when the previous one actually made it into the queue, so a
+ * stalled pipeline shows up as latency instead of as a lower sending rate (no coordinated omission).
+ */
+typedef struct {
+    long nextNs;       // intended send time of the next article
+    int numProducers;  // the number of producers sharing the configured rate
+    int burstLeft;
+    unsigned int seed;
+} ArrivalSchedule;
+
+typedef struct {
+    long counts[LATENCY_BUCKETS];
+    long total;
+    long maxNs;
+} LatencyHistogram;
+
+long monotonicNs();
+
+void startLoad();
+
+long loadStartTime();
+
+long arriveAt(long offsetNs);
+
+void initSchedule(ArrivalSchedule* schedule, int numProducers, unsigned int seed);
+
+long nextArrival(ArrivalSchedule* schedule);
+
+void recordLatency(const Article* article);
+
+void printLoadReport(FILE* out);
+
+#endif
@@ -0,0 +1,118 @@
+#include "Memory.h"
+#include "../WaitStrategy/WaitStrategy.h"
+#include "../Trace/Trace.h"
+
+/**
+ * The memory accounting of MEMORY: an account per stage, charged by the queues of the stage as
+ * articles enter and leave them, and a thread that dumps the accounts every interval. The summary
+ * at the end gives the most every stage held at once, to size its queues from.
+ */
+typedef struct {
+    int enabled;
+    MemoryAccount accounts[NUM_MEMORY_STAGES];
+    sem_t stop;
+    pthread_t thread;
+    int running;
+} MemoryReport;
+
+static MemoryReport memoryReport;
+
+static const char* stageNames[NUM_MEMORY_STAGES] = {"producers", "categories", "shared"};
+
+/**
+ * Returns the account of a stage, for its queues to charge.
+ *
+ * @param stage The stage.
+ * @return The account, or NULL when memory accounting is disabled.
+ */
+MemoryAccount* memoryAccount(MemoryStage stage) {
+    if (config.memoryReportMs < 0) {
+        return NULL;
+    }
+    return &memoryReport.accounts[stage];
+}
+
+// writes a number of bytes in B, KB or MB
+static void formatBytes(char* out, size_t size, long bytes) {
+    if (bytes < 10 * 1024) {
+        snprintf(out, size, "%ld B", bytes);
+    } else if (bytes < 10 * 1024 * 1024) {
+        snprintf(out, size, "%.1f KB", bytes / 1024.0);
+    } else {
+        snprintf(out, size, "%.1f MB", bytes / (1024.0 * 1024.0));
+    }
+}
+
+/**
+ * Writes the current articles and bytes of every stage on a single line.
+ */
+static void dumpAccounts(FILE* report) {
+    char line[512];
+    int length = snprintf(line, sizeof(line), "Memory:");
+    for (int i = 0; i < NUM_MEMORY_STAGES; i++) {
+        MemoryAccount* account = &memoryReport.accounts[i];
+        char bytes[32];
+        char queueBytes[32];
+        formatBytes(bytes, sizeof(bytes), __atomic_load_n(&account->bytes, __ATOMIC_RELAXED));
+        formatBytes(queueBytes, sizeof(queueBytes), __atomic_load_n(&account->queueBytes, __ATOMIC_RELAXED));
+        length += snprintf(line + length, sizeof(line) - length, " %s %ld articles %s + queues %s;", stageNames[i],
+                           __atomic_load_n(&account->items, __ATOMIC_RELAXED), bytes, queueBytes);
+    }
+    fprintf(report, "%s\n", line);
+}
+
+/**
+ * The reporting thread, dumps the accounts every interval until stopMemoryReport.
+ */
+static void* reportMemory(void* arg) {
+    TRACE_THREAD("memory", 0);
+    while (1) {
+        struct timespec deadline;
+        deadlineAfterMs(&deadline, config.memoryReportMs);
+        if (sem_timedwait(&memoryReport.stop, &deadline) == 0) {
+            break;
+        }
+        dumpAccounts(stderr);
+    }
+    return NULL;
+}
+
+/**
+ * Starts the periodic dumps, when MEMORY gives an interval.
+ */
+void startMemoryReport() {
+    if (config.memoryReportMs <= 0) {
+        return;
+    }
+    sem_init(&memoryReport.stop, 0, 0);
+    pthread_create(&memoryReport.thread, NULL, reportMemory, NULL);
+    memoryReport.running = 1;
+}
+
+/**
+ * Stops the periodic dumps, and writes the peak and the final memory of every stage, when MEMORY is set.
+ *
+ * @param report Where to write the summary.
+ */
+void stopMemoryReport(FILE* report) {
+    if (config.memoryReportMs < 0) {
+        return;
+    }
+    if (memoryReport.running) {
+        sem_post(&memoryReport.stop);
+        pthread_join(memoryReport.thread, NULL);
+        sem_destroy(&memoryReport.stop);
+        memoryReport.running = 0;
+    }
+    for (int i = 0; i < NUM_MEMORY_STAGES; i++) {
+        MemoryAccount* account = &memoryReport.accounts[i];
+        char peakBytes[32];
+        char peakQueueBytes[32];
+        char bytes[32];
+        formatBytes(peakBytes, sizeof(peakBytes), account->peakBytes);
+        formatBytes(peakQueueBytes, sizeof(peakQueueBytes), account->peakQueueBytes);
+        formatBytes(bytes, sizeof(bytes), account->bytes + account->queueBytes);
+        fprintf(report, "Memory: %s: peak %ld articles, %s in articles, %s in queues, %s at the end\n", stageNames[i],
+                account->peakItems, peakBytes, peakQueueBytes, bytes);
+    }
+}
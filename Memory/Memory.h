@@ -0,0 +1,74 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <semaphore.h>
+#include <pthread.h>
+
+#include "../Config/Config.h"
+
+// The stages whose queues hold articles.
+typedef enum {
+    MEMORY_PRODUCERS,  // the producer queues
+    MEMORY_CATEGORIES, // the category queues of the dispatcher
+    MEMORY_SHARED,     // the shared buffer of the screen manager
+    NUM_MEMORY_STAGES
+} MemoryStage;
+
+/**
+ * The memory held by the queues of a stage, and the most it ever held: the articles inside them,
+ * counted with the bytes the allocator reserved for each article and its text (see
+ * articleFootprint; a text shared by fanned-out copies counts for each copy), and the queues
+ * themselves (their structs and slot arrays). Updated atomically by the queues.
+ */
+typedef struct {
+    long items;
+    long bytes;
+    long queueBytes;
+    long peakItems;
+    long peakBytes;
+    long peakQueueBytes;
+} MemoryAccount;
+
+// raises a peak to a new value
+static inline void raisePeak(long* peak, long value) {
+    long seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (value > seen && !__atomic_compare_exchange_n(peak, &seen, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * Adds (or removes, with negative values) articles to the account of a stage, and raises its peaks.
+ *
+ * @param account The account of the stage, NULL when memory accounting is disabled.
+ * @param items   The articles added.
+ * @param bytes   Their bytes.
+ */
+static inline void chargeMemory(MemoryAccount* account, long items, long bytes) {
+    if (account == NULL) {
+        return;
+    }
+    raisePeak(&account->peakItems, __atomic_add_fetch(&account->items, items, __ATOMIC_RELAXED));
+    raisePeak(&account->peakBytes, __atomic_add_fetch(&account->bytes, bytes, __ATOMIC_RELAXED));
+}
+
+/**
+ * Adds (or removes) the bytes of queue structs and slot arrays to the account of a stage.
+ *
+ * @param account The account of the stage, NULL when memory accounting is disabled.
+ * @param bytes   The bytes.
+ */
+static inline void chargeQueue(MemoryAccount* account, long bytes) {
+    if (account != NULL) {
+        raisePeak(&account->peakQueueBytes, __atomic_add_fetch(&account->queueBytes, bytes, __ATOMIC_RELAXED));
+    }
+}
+
+MemoryAccount* memoryAccount(MemoryStage stage);
+
+void startMemoryReport();
+
+void stopMemoryReport(FILE* report);
+
+#endif
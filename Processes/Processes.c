@@ -0,0 +1,328 @@
+#include "Processes.h"
+#include "../CoEditor/CoEditor.h"
+
+/**
+ * The multi-process mode: the producers, the co-editors and the screen manager each run in a child
+ * process, while the dispatcher stays in the main process. The producer queues and the shared buffer
+ * become views of rings in POSIX shared memory, one segment per queue. The category queues are
+ * unbounded, so they can't live in a fixed segment: the dispatcher inserts into a ring per category
+ * instead, which the co-editors' process drains into its own unbounded queues (where the admission
+ * policies and the spilling apply).
+ */
+typedef enum {
+    PROCESS_PRODUCERS,
+    PROCESS_CO_EDITORS,
+    PROCESS_SCREEN_MANAGER,
+    NUM_STAGE_PROCESSES
+} StageProcess;
+
+static const char* processNames[NUM_STAGE_PROCESSES] = {"producers", "co-editors", "screen manager"};
+
+/**
+ * A stage that dies takes the articles it held with it, and leaves the stages on the other side of
+ * its rings waiting forever, so the children are watched by a thread of their own: the first one to
+ * end abnormally stops the whole run. Restarting or scaling a stage process isn't supported.
+ */
+typedef struct {
+    ShmRing** rings;
+    char (*names)[64];
+    int numRings;
+    ShmRing* categoryRings[NUM_MESSAGE_TYPES];
+    pid_t pids[NUM_STAGE_PROCESSES];
+    sem_t ended[NUM_STAGE_PROCESSES]; // posted once the watcher reaped the process
+    pthread_t watcher;
+    int watching;
+} Stages;
+
+static Stages stages;
+
+// a thread of the co-editors' process, moving the articles of a category ring to the category queue
+typedef struct {
+    ShmRing* ring;
+    UnboundedBuffer* queue;
+    pthread_t thread;
+} CategoryFeed;
+
+/**
+ * Creates the named segment of a queue.
+ */
+static ShmRing* createStageRing(const char* queue, int capacity) {
+    char* name = stages.names[stages.numRings];
+    snprintf(name, sizeof(stages.names[0]), "/concurrent-news-%d-%s", (int)getpid(), queue);
+    ShmRing* ring = createShmRing(name, capacity);
+    if (ring != NULL) {
+        stages.rings[stages.numRings++] = ring;
+    }
+    return ring;
+}
+
+/**
+ * Creates the named segment of a bounded queue, and a view of it.
+ */
+static BoundedBuffer* createStageBuffer(const char* queue, int capacity) {
+    ShmRing* ring = createStageRing(queue, capacity);
+    return ring != NULL ? initSharedBuffer(ring) : NULL;
+}
+
+/**
+ * Moves the articles of a category ring to the category queue, up to the dispatcher's "DONE".
+ */
+static void* feedCategory(void* arg) {
+    CategoryFeed* feed = (CategoryFeed*)arg;
+    int done = 0;
+    while (!done) {
+        Article* article = shmRingPop(feed->ring, -1);
+        done = isDone(article);
+        insertUnBounded(feed->queue, article);
+    }
+    return NULL;
+}
+
+/**
+ * The co-editors' process: runs the co-editors on category queues of its own, fed from the rings.
+ */
+static void runCoEditorProcess() {
+    // the co-editors only use the queues of the dispatcher
+    Dispatcher dispatcher;
+    if (posix_memalign((void**)&dispatcher.dispatcherQueues, CACHE_LINE_SIZE,
+                       sizeof(UnboundedBuffer) * NUM_MESSAGE_TYPES) != 0) {
+        fprintf(stderr, "Error allocating the category queues.\n");
+        exit(1);
+    }
+    initCategoryQueues(dispatcher.dispatcherQueues);
+    CategoryFeed feeds[NUM_MESSAGE_TYPES];
+    for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+        feeds[i].ring = stages.categoryRings[i];
+        feeds[i].queue = &dispatcher.dispatcherQueues[i];
+        pthread_create(&feeds[i].thread, NULL, feedCategory, &feeds[i]);
+    }
+    runCoEditors(&dispatcher);
+    for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+        pthread_join(feeds[i].thread, NULL);
+    }
+    destroyCategoryQueues(dispatcher.dispatcherQueues);
+    free(dispatcher.dispatcherQueues);
+}
+
+/**
+ * Reaps the stage processes as they end. One that didn't end normally stops the run: the others are
+ * killed, the segments removed, and the program exits with status 1.
+ */
+static void* watchStages(void* arg) {
+    int reaped[NUM_STAGE_PROCESSES] = {0};
+    int running = NUM_STAGE_PROCESSES;
+    while (running > 0) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("waitpid");
+            return NULL;
+        }
+        int process = 0;
+        while (process < NUM_STAGE_PROCESSES && stages.pids[process] != pid) {
+            process++;
+        }
+        if (process == NUM_STAGE_PROCESSES) {
+            continue;
+        }
+        if (!(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+            if (WIFSIGNALED(status)) {
+                fprintf(stderr, "The %s process ended abnormally (signal %d), stopping.\n", processNames[process],
+                        WTERMSIG(status));
+            } else {
+                fprintf(stderr, "The %s process ended abnormally (exit status %d), stopping.\n",
+                        processNames[process], WEXITSTATUS(status));
+            }
+            for (int i = 0; i < NUM_STAGE_PROCESSES; i++) {
+                if (i != process && !reaped[i]) {
+                    kill(stages.pids[i], SIGKILL);
+                }
+            }
+            // the mappings go away with the processes, the names would stay
+            for (int i = 0; i < stages.numRings; i++) {
+                shm_unlink(stages.names[i]);
+            }
+            exit(1);
+        }
+        reaped[process] = 1;
+        sem_post(&stages.ended[process]);
+        running--;
+    }
+    return NULL;
+}
+
+/**
+ * Waits for a stage process to end normally (see watchStages).
+ */
+static void waitStage(StageProcess process) {
+    if (stages.watching) {
+        sem_wait(&stages.ended[process]);
+    }
+}
+
+/**
+ * Runs a stage in the child process of a fork, which is killed along with its parent. Returns in the parent.
+ */
+static void forkStage(StageProcess process, pid_t parent) {
+    stages.pids[process] = fork();
+    if (stages.pids[process] < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (stages.pids[process] > 0) {
+        return;
+    }
+    // a stage left without the dispatcher would wait on its rings forever
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != parent) {
+        exit(1);
+    }
+    switch (process) {
+    case PROCESS_PRODUCERS:
+        runProducers();
+        // the process ends with its last producer thread (a sanitizer's own thread may outlive them)
+        joinProducers();
+        break;
+    case PROCESS_CO_EDITORS:
+        runCoEditorProcess();
+        break;
+    default:
+        screenManager(NULL);
+        break;
+    }
+    exit(0);
+}
+
+/**
+ * Moves the queues between the stages to shared memory, and starts the producers, the co-editors
+ * and the screen manager in their own processes. Must be called before the process starts any thread.
+ *
+ * @return 0 on success, -1 if the stages can't be split (the caller runs them as threads).
+ */
+int startStageProcesses() {
+    if (config.journalPath != NULL) {
+        fprintf(stderr, "The journal is written by a single process, running the stages as threads.\n");
+        return -1;
+    }
+    if (config.recordPath != NULL || config.replayPath != NULL) {
+        fprintf(stderr, "The stages are recorded by a single process, running the stages as threads.\n");
+        return -1;
+    }
+    if (config.controlPath != NULL) {
+        fprintf(stderr, "The control channel adds producers to this process, running the stages as threads.\n");
+        return -1;
+    }
+    if (config.checkpointPath != NULL) {
+        fprintf(stderr, "A checkpoint is taken by a single process, running the stages as threads.\n");
+        return -1;
+    }
+    if (config.memoryReportMs >= 0) {
+        fprintf(stderr, "The memory is accounted in a single process, running the stages as threads.\n");
+        return -1;
+    }
+    // every process counts into the same audit
+    if (shareAudit() != 0) {
+        return -1;
+    }
+    stages.rings = malloc(sizeof(ShmRing*) * (numProducers + 1 + NUM_MESSAGE_TYPES));
+    stages.names = malloc(sizeof(stages.names[0]) * (numProducers + 1 + NUM_MESSAGE_TYPES));
+    stages.numRings = 0;
+
+    BoundedBuffer* producerBuffers[numProducers];
+    for (int i = 0; i < numProducers; i++) {
+        char queue[32];
+        snprintf(queue, sizeof(queue), "producer-%d", i);
+        producerBuffers[i] = createStageBuffer(queue, producers[i]->queueSize);
+        if (producerBuffers[i] == NULL) {
+            for (int j = 0; j < i; j++) {
+                destroyBuffer(producerBuffers[j]);
+            }
+            stopStageProcesses();
+            return -1;
+        }
+    }
+    BoundedBuffer* shared = createStageBuffer("shared", coEditorBufferSize);
+    if (shared == NULL) {
+        for (int i = 0; i < numProducers; i++) {
+            destroyBuffer(producerBuffers[i]);
+        }
+        stopStageProcesses();
+        return -1;
+    }
+    for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+        char queue[32];
+        snprintf(queue, sizeof(queue), "category-%d", i);
+        stages.categoryRings[i] = createStageRing(queue, CATEGORY_RING_SIZE);
+        if (stages.categoryRings[i] == NULL) {
+            for (int j = 0; j < numProducers; j++) {
+                destroyBuffer(producerBuffers[j]);
+            }
+            destroyBuffer(shared);
+            stopStageProcesses();
+            return -1;
+        }
+    }
+    for (int i = 0; i < numProducers; i++) {
+        destroyBuffer(producers[i]->buffer);
+        producers[i]->buffer = producerBuffers[i];
+    }
+    sharedBuffer = shared;
+    startLoad();
+
+    // don't let the children inherit (and print again) what is buffered
+    fflush(stdout);
+    fflush(stderr);
+    pid_t parent = getpid();
+    for (int i = 0; i < NUM_STAGE_PROCESSES; i++) {
+        forkStage(i, parent);
+    }
+    for (int i = 0; i < NUM_STAGE_PROCESSES; i++) {
+        sem_init(&stages.ended[i], 0, 0);
+    }
+    pthread_create(&stages.watcher, NULL, watchStages, NULL);
+    stages.watching = 1;
+    return 0;
+}
+
+/**
+ * Returns the ring the dispatcher inserts the articles of a category into.
+ *
+ * @param category The category.
+ */
+ShmRing* categoryRing(int category) {
+    return stages.categoryRings[category];
+}
+
+/**
+ * Waits for the co-editors' process to pass on its last article, and for the screen manager process
+ * to display it.
+ */
+void waitEditingProcesses() {
+    waitStage(PROCESS_CO_EDITORS);
+    waitStage(PROCESS_SCREEN_MANAGER);
+}
+
+/**
+ * Waits for the stage processes and removes the shared memory segments.
+ */
+void stopStageProcesses() {
+    if (stages.watching) {
+        // every process ended normally once the watcher is done
+        pthread_join(stages.watcher, NULL);
+        for (int i = 0; i < NUM_STAGE_PROCESSES; i++) {
+            sem_destroy(&stages.ended[i]);
+        }
+        stages.watching = 0;
+    }
+    for (int i = 0; i < stages.numRings; i++) {
+        destroyShmRing(stages.rings[i], stages.names[i]);
+    }
+    free(stages.rings);
+    free(stages.names);
+    stages.rings = NULL;
+    stages.names = NULL;
+    stages.numRings = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef PROCESSES_H
+#define PROCESSES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <signal.h>
+#include <errno.h>
+#include <semaphore.h>
+
+#include "../globals.h"
+#include "../Config/Config.h"
+#include "../ShmRing/ShmRing.h"
+#include "../ScreenManager/ScreenManager.h"
+
+// the articles a category ring holds: its co-editors' process moves them on to an unbounded queue
+#define CATEGORY_RING_SIZE 64
+
+int startStageProcesses();
+
+ShmRing* categoryRing(int category);
+
+void waitEditingProcesses();
+
+void stopStageProcesses();
+
+#endif
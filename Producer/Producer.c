@@ -1,4 +1,5 @@
 #include "Producer.h"
+#include "../globals.h"
 
 /**
  * Creates a producer with the specified ID, number of products, and queue size.
@@ -14,6 +15,147 @@ void createProducer(Producer* producer, char* producerID, char* numOfProducts, c
     producer->numProducts = atoi(numOfProducts);
     producer->queueSize = atoi(queueSize);
     producer->buffer = initBuffer(producer->queueSize);
+    producer->type = PRODUCER_SYNTHETIC;
+    producer->path = NULL;
+    producer->replay = NULL;
+    producer->replayNs = NULL;
+    producer->numReplay = 0;
+    producer->resumeAt = 0;
+    producer->progress = 0;
+    producer->resumedSeq = 0;
+    producer->started = 0;
+    producer->retired = 0;
+}
+
+/**
+ * Creates a producer that streams the articles of an input file, one per line.
+ *
+ * @param producer Pointer to the Producer struct to be created.
+ * @param producerID The ID of the producer.
+ * @param path The input file, "-" for stdin.
+ * @param queueSize The size of the producer's queue.
+ */
+void createIngestProducer(Producer* producer, int producerID, const char* path, int queueSize) {
+    producer->producerID = producerID;
+    producer->numProducts = 0;
+    producer->queueSize = queueSize;
+    producer->buffer = initBuffer(queueSize);
+    producer->type = PRODUCER_FILE;
+    producer->path = strdup(path);
+    producer->replay = NULL;
+    producer->replayNs = NULL;
+    producer->numReplay = 0;
+    producer->resumeAt = 0;
+    producer->progress = 0;
+    producer->resumedSeq = 0;
+    producer->started = 0;
+    producer->retired = 0;
+}
+
+/**
+ * Creates a producer that replays the given articles (those a journal recovery found unpublished, or
+ * those of a recording).
+ *
+ * @param producer Pointer to the Producer struct to be created.
+ * @param producerID The ID of the producer.
+ * @param articles The articles to replay, the producer takes ownership of them and of the array.
+ * @param arrivalsNs When to send each article, since the start of the load (the producer takes ownership
+ *                   of the array), NULL to send them at once.
+ * @param numArticles The number of articles.
+ */
+void createReplayProducer(Producer* producer, int producerID, Article** articles, long* arrivalsNs, int numArticles) {
+    producer->producerID = producerID;
+    producer->numProducts = numArticles;
+    producer->queueSize = 64;
+    producer->buffer = initBuffer(producer->queueSize);
+    producer->type = PRODUCER_REPLAY;
+    producer->path = NULL;
+    producer->replay = articles;
+    producer->replayNs = arrivalsNs;
+    producer->numReplay = numArticles;
+    producer->resumeAt = 0;
+    producer->progress = 0;
+    producer->resumedSeq = 0;
+    producer->started = 0;
+    producer->retired = 0;
+}
+
+// the capacity of the producers array
+static int producersCapacity = 0;
+
+sem_t producersMutex;
+
+/**
+ * Adds a producer to the producers array, growing it (and the messages array) when needed.
+ *
+ * @param producer The producer to add.
+ */
+void addProducer(Producer* producer) {
+    sem_wait(&producersMutex);
+    // check for a need of reallocation
+    if (numProducers >= producersCapacity) {
+        producersCapacity *= 2;
+        producers = realloc(producers, producersCapacity * sizeof(Producer*));
+        messages = realloc(messages, producersCapacity * sizeof(char*));
+    }
+    producer->index = numProducers;
+    producers[numProducers] = producer;
+    messages[numProducers] = NULL;
+    numProducers++;
+    sem_post(&producersMutex);
+}
+
+/**
+ * Adds a producer to the producers array and starts its thread, while the system runs.
+ *
+ * @param producer The producer to start.
+ * @return The index of the producer.
+ */
+int startProducer(Producer* producer) {
+    accountBuffer(producer->buffer, memoryAccount(MEMORY_PRODUCERS));
+    addProducer(producer);
+    producer->started = 1;
+    pthread_create(&producer->thread, NULL, produce, producer);
+    return producer->index;
+}
+
+/**
+ * Reads the next line of the configuration file that holds a number.
+ * Empty lines are skipped, and option lines ("KEY value") are applied on the way.
+ *
+ * @param configFile The configuration file.
+ * @param line       Pointer to the getline buffer.
+ * @param len        Pointer to the size of the getline buffer.
+ * @return The number of bytes read, or -1 on EOF.
+ */
+ssize_t readConfigLine(FILE* configFile, char** line, size_t* len) {
+    ssize_t bytesRead;
+    while ((bytesRead = getline(line, len, configFile)) != -1) {
+        char* start = *line + strspn(*line, " \t\r\n");
+        if (*start == '\0') {
+            // Skip empty lines
+            continue;
+        }
+        if (strncmp(start, "INGEST", 6) == 0) {
+            // "INGEST <path> <queue size>" adds a producer streaming the lines of a file
+            char path[4096];
+            int queueSize;
+            if (sscanf(start + 6, " %4095s %d", path, &queueSize) == 2) {
+                Producer* producer = malloc(sizeof(Producer));
+                createIngestProducer(producer, numProducers, path, queueSize);
+                addProducer(producer);
+            } else {
+                fprintf(stderr, "Invalid INGEST line: %s", start);
+            }
+            continue;
+        }
+        if (isalpha((unsigned char)*start)) {
+            parseOption(start);
+            continue;
+        }
+        return bytesRead;
+    }
+    return -1;
 }
 
 /**
@@ -32,75 +174,126 @@ void readConfigurationFile(const char* filename) {
     }
 
     // Initial capacity of the producers array
-    int capacity = 10;
-    producers = malloc(capacity * sizeof(Producer*));
+    producersCapacity = 10;
+    producers = malloc(producersCapacity * sizeof(Producer*));
+    messages = malloc(producersCapacity * sizeof(char*));
     numProducers = 0;
+    sem_init(&producersMutex, 0, 1);
 
     char* line = NULL, *tempLine = NULL, *thirdLine = NULL;
     size_t len = 0, tempLen = 0, thirdLen = 0;
-    ssize_t bytesRead;
 
-    // Read the configuration file line by line
-    while ((bytesRead = getline(&line, &len, configFile)) != -1) {
-        if (bytesRead == 1 && line[0] == '\n') {
-            // Skip empty lines
-            continue;
-        }
-
-        getline(&tempLine, &tempLen, configFile);
-
-
-        int thirdTempLine = getline(&thirdLine, &thirdLen, configFile);
+    // Read the configuration file, three lines per producer
+    while (readConfigLine(configFile, &line, &len) != -1) {
         //EOF
-        if(thirdTempLine == -1){
-            // Set the Co-Editor queue size
+        if (readConfigLine(configFile, &tempLine, &tempLen) == -1) {
+            // The last line is the Co-Editor queue size
             coEditorBufferSize = atoi(line);
             break;
         }
-
-        // check for a need of reallocation
-        if (numProducers >= capacity) {
-            capacity *= 2;
-            producers = realloc(producers, capacity * sizeof(Producer*));
-        }
+        readConfigLine(configFile, &thirdLine, &thirdLen);
 
         //create and add the new producer
         Producer* producer = malloc(sizeof(Producer));
         createProducer(producer, line, tempLine, thirdLine);
-        producers[numProducers] = producer;
-        numProducers++;
+        addProducer(producer);
         
     }
+    free(line);
+    free(tempLine);
+    free(thirdLine);
     fclose(configFile);
 }
 
 /**
  * Generates articles and inserts them into the bounded buffer.
+ * A producer resumed from a checkpoint skips the articles it sent before, and a producer of a run
+ * stopped for a checkpoint (see checkpointRequested) stops early; either way it ends with "DONE".
  *
- * @param arg A void pointer to the index of the Producer.
+ * @param arg A pointer to the Producer.
  * @return A void pointer to indicate the completion of the thread.
  */
 void* produce(void* arg) {
-    int j = (int)arg;
+    Producer* producer = (Producer*)arg;
+    int j = producer->index;
+    TRACE_THREAD("producer %d", j);
+    if (producer->type == PRODUCER_FILE) {
+        ingestFile(producer, j);
+        return NULL;
+    }
+    if (producer->type == PRODUCER_REPLAY) {
+        int i = 0;
+        for (; i < producer->numReplay && i < producer->resumeAt; i++) {
+            freeArticle(producer->replay[i]);
+        }
+        for (; i < producer->numReplay && !checkpointRequested(); i++) {
+            producer->replay[i]->producer = j;
+            if (producer->replayNs != NULL) {
+                // a recording is replayed on its own schedule
+                producer->replay[i]->intendedNs = arriveAt(producer->replayNs[i]);
+            }
+            auditProduced(producer->replay[i]);
+            recordArrival(producer->replay[i]);
+            insertBounded(producer->buffer, producer->replay[i]);
+            jitter();
+        }
+        producer->progress = i;
+        // the articles left of a stopped run are sent again by the next one
+        for (; i < producer->numReplay; i++) {
+            freeArticle(producer->replay[i]);
+        }
+        insertBounded(producer->buffer, newDone());
+        return NULL;
+    }
     char* message = malloc(sizeof(char)* MAX_MESSAGE_LENGTH);
     char* articleTypes[3] = {"SPORTS", "NEWS", "WEATHER"};
-    int articleTypeCounter = 0;
-    for (int i = 0; i < producers[j]->numProducts; i++) {
+    int articleTypeCounter = producer->resumeAt / 3;
+
+    // with a configured rate, the generating producers share it and send on an open-loop schedule
+    int rateControlled = config.rate > 0 || config.rampStepMs > 0;
+    ArrivalSchedule schedule;
+    if (rateControlled) {
+        int numGenerating = 0;
+        sem_wait(&producersMutex);
+        for (int k = 0; k < numProducers; k++) {
+            numGenerating += producers[k]->type == PRODUCER_SYNTHETIC;
+        }
+        sem_post(&producersMutex);
+        initSchedule(&schedule, numGenerating, j + 1);
+    }
+    int i = producer->resumeAt;
+    for (; i < producer->numProducts && !checkpointRequested(); i++) {
         // Determine the article type based on modulo 3 operation
         int typeIndex = i % 3;
         // set the articles
-        if (i % 3 == 0 && i != 0){
+        if (i % 3 == 0 && i > producer->resumeAt){
             articleTypeCounter++;
         }
         // create the message
-        snprintf(message, MAX_MESSAGE_LENGTH, "Producer %d %s %d", producers[j]->producerID, articleTypes[typeIndex], articleTypeCounter);
+        snprintf(message, MAX_MESSAGE_LENGTH, "Producer %d %s %d", producer->producerID, articleTypes[typeIndex], articleTypeCounter);
+        // every BREAKING_EVERY-th news article is breaking news, and takes the high priority lane
+        int priority = PRIORITY_NORMAL;
+        if (typeIndex == 1 && config.breakingEvery > 0 && (articleTypeCounter + 1) % config.breakingEvery == 0) {
+            priority = PRIORITY_HIGH;
+        }
         // insert the article to the buffer
-        insertBounded(producers[j]->buffer, message);
-       
+        Article* article = newArticle(message, priority);
+        article->producer = j;
+        if (rateControlled) {
+            article->intendedNs = nextArrival(&schedule);
+        }
+        journalAccept(article);
+        auditProduced(article);
+        recordArrival(article);
+        insertBounded(producer->buffer, article);
+        jitter();
     }
+    producer->progress = i < producer->numProducts ? i : producer->numProducts;
 
-    insertBounded(producers[j]->buffer, "DONE");
+    insertBounded(producer->buffer, newDone());
+    sem_wait(&producersMutex);
     messages[j] = message;
+    sem_post(&producersMutex);
 
     return NULL;
 }
@@ -108,21 +301,25 @@ void* produce(void* arg) {
 /**
  * Runs the producer threads.
  * Creates and starts threads for each producer in the producers array.
- *
- * @return Pointer to the array of producer thread IDs (pthread_t).
  */
-pthread_t* runProducers() {
-    messages = malloc(numProducers * sizeof(char*));
+void runProducers() {
+    startLoad();
 
-    pthread_t producerThreads[numProducers];
     for (int i = 0; i < numProducers; i++) {
-
-        pthread_create(&producerThreads[i], NULL, produce, (void*)i);
+        accountBuffer(producers[i]->buffer, memoryAccount(MEMORY_PRODUCERS));
+        producers[i]->started = 1;
+        pthread_create(&producers[i]->thread, NULL, produce, producers[i]);
     }
-    return producerThreads;
+}
 
-    // Wait for all producer threads to finish
-//    for (int i = 0; i < numProducers; i++) {
-//        pthread_join(producerThreads[i], NULL);
-//    }
+/**
+ * Waits for the producer threads of this process, including those the control channel started.
+ * No producer may be added anymore.
+ */
+void joinProducers() {
+    for (int i = 0; i < numProducers; i++) {
+        if (producers[i]->started) {
+            pthread_join(producers[i]->thread, NULL);
+        }
+    }
 }
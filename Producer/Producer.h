@@ -4,21 +4,66 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>  
+#include <ctype.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include "../BoundedBuffer/BoundedBuffer.h"
+#include "../Config/Config.h"
+
+// Where a producer's articles come from.
+typedef enum {
+    PRODUCER_SYNTHETIC, // generates "Producer <id> <type> <n>" articles
+    PRODUCER_FILE,      // streams the lines of a file, or of stdin
+    PRODUCER_REPLAY     // replays the articles a recovery found unpublished, or those of a recording
+} ProducerType;
 
 typedef struct {
+    int index; // position in the producers array
     int producerID;
     int numProducts;
     int queueSize;
     BoundedBuffer* buffer;
+    ProducerType type;
+    char* path; // the input of a PRODUCER_FILE producer, "-" for stdin
+    Article** replay; // the articles of a PRODUCER_REPLAY producer
+    long* replayNs;   // their recorded arrival times (since the start of the load), NULL to send them at once
+    int numReplay;
+    int resumeAt;   // the articles it sent before the checkpoint it resumes from, skipped this time
+    int progress;   // the articles it sent so far (counting the skipped ones), saved by a checkpoint
+    int resumedSeq; // the sequence numbers its articles restored from a checkpoint took
+    pthread_t thread;
+    int started; // the thread runs in this process
+    int retired; // set by the dispatcher once the producer's DONE went through
 } Producer;
 
+// guards the producers and messages arrays, which the control channel grows while the system runs
+extern sem_t producersMutex;
+
 void createProducer(Producer* producer, char* producerID, char* numOfProducts, char* queueSize);
 
+void createIngestProducer(Producer* producer, int producerID, const char* path, int queueSize);
+
+void createReplayProducer(Producer* producer, int producerID, Article** articles, long* arrivalsNs, int numArticles);
+
+void addProducer(Producer* producer);
+
+int startProducer(Producer* producer);
+
+ssize_t readConfigLine(FILE* configFile, char** line, size_t* len);
+
 void readConfigurationFile(const char* filename);
 
 void* produce(void* arg);
 
-pthread_t* runProducers();
+void runProducers();
+
+void joinProducers();
+
+#include "../Ingest/Ingest.h"
+#include "../LoadGenerator/LoadGenerator.h"
+#include "../Journal/Journal.h"
+#include "../Stress/Stress.h"
+#include "../Replay/Replay.h"
+#include "../Checkpoint/Checkpoint.h"
 
 #endif
\ No newline at end of file
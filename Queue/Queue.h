@@ -0,0 +1,268 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <semaphore.h>
+
+#include "../cacheline.h"
+#include "../WaitStrategy/WaitStrategy.h"
+
+/**
+ * Type-generic FIFO queues, generated per element type. The elements are stored by value in a
+ * contiguous array of slots, so a queue of small records needs no allocation and no pointer chase
+ * per element.
+ *
+ * DEFINE_RING(Name, Type) generates an unsynchronized ring, for code that does its own locking
+ * (the lanes of the unbounded buffers are ArticleRings, those of the bounded buffers LaneRings):
+ *
+ *   void NameInit(Name* ring, int size);            void NameDestroy(Name* ring);
+ *   int NamePush(Name* ring, Type item);            0, or -1 when the ring is full
+ *   int NamePop(Name* ring, Type* item);            0, or -1 when the ring is empty
+ *   Type* NamePeek(Name* ring);                     the oldest item, NULL when the ring is empty
+ *   Type* NameAt(Name* ring, int i);                the i-th oldest item
+ *   void NameResize(Name* ring, int size);          keeps the items in order (size >= count)
+ *
+ * DEFINE_STATIC_RING(Name, Type, Capacity) generates the same ring with its slots inline and a
+ * capacity fixed at compile time, a power of two: the indices run free and are masked, so no index
+ * wraps around with a branch or a division. Resize only changes the logical size, up to Capacity.
+ * The specialized build (make static) uses it for the LaneRings of the bounded buffers.
+ *
+ * DEFINE_QUEUE(Name, Type) generates a bounded, thread-safe queue on top of a NameRing, waiting
+ * according to the configured wait strategy. Every variant goes through one transfer function, which
+ * takes its slots with acquireSlots (as do the article buffers, which keep their own storage):
+ *
+ *   void NamePush(Name* q, Type item);              int NamePop(Name* q, Type* item);    (blocking)
+ *   int NameTryPush(Name* q, Type item);            int NameTryPop(Name* q, Type* item); (1 if done)
+ *   int NameTimedPush(Name* q, Type item, long ms); int NameTimedPop(Name* q, Type* item, long ms);
+ *   void NamePushBatch(Name* q, const Type* items, int n);  pushes all n items, in order
+ *   int NamePopBatch(Name* q, Type* items, int max);        waits for one item, takes up to max
+ */
+
+/**
+ * Takes up to n permits of a semaphore counting the free (or filled) slots of a queue: waits for the
+ * first one (timeoutMs < 0: as long as it takes, 0: not at all), and takes the others only if they
+ * are there right away. The caller then moves one item per permit under its lock.
+ *
+ * @return The permits taken, 0 if none came in time.
+ */
+static inline int acquireSlots(sem_t* sem, WaitState* wait, int n, long timeoutMs) {
+    if (timeoutMs == 0) {
+        if (sem_trywait(sem) != 0) {
+            return 0;
+        }
+    } else if (timeoutMs < 0) {
+        waitFor(sem, wait);
+    } else {
+        struct timespec deadline;
+        deadlineAfterMs(&deadline, timeoutMs);
+        if (waitForUntil(sem, wait, &deadline) != 0) {
+            return 0;
+        }
+    }
+    int taken = 1;
+    while (taken < n && sem_trywait(sem) == 0) {
+        taken++;
+    }
+    return taken;
+}
+
+#define DEFINE_RING(Name, Type)                                                                   \
+typedef struct {                                                                                  \
+    Type* slots;                                                                                  \
+    int size;                                                                                     \
+    int count;                                                                                    \
+    int in;                                                                                       \
+    int out;                                                                                      \
+} Name;                                                                                           \
+                                                                                                  \
+static inline void Name##Init(Name* ring, int size) {                                             \
+    ring->slots = malloc(sizeof(Type) * size);                                                    \
+    ring->size = size;                                                                            \
+    ring->count = 0;                                                                              \
+    ring->in = 0;                                                                                 \
+    ring->out = 0;                                                                                \
+}                                                                                                 \
+                                                                                                  \
+static inline void Name##Destroy(Name* ring) {                                                    \
+    free(ring->slots);                                                                            \
+}                                                                                                 \
+                                                                                                  \
+static inline int Name##Push(Name* ring, Type item) {                                             \
+    if (ring->count == ring->size) {                                                              \
+        return -1;                                                                                \
+    }                                                                                             \
+    ring->slots[ring->in] = item;                                                                 \
+    ring->in = ring->in + 1 == ring->size ? 0 : ring->in + 1;                                     \
+    ring->count++;                                                                                \
+    return 0;                                                                                     \
+}                                                                                                 \
+                                                                                                  \
+static inline int Name##Pop(Name* ring, Type* item) {                                             \
+    if (ring->count == 0) {                                                                       \
+        return -1;                                                                                \
+    }                                                                                             \
+    *item = ring->slots[ring->out];                                                               \
+    ring->out = ring->out + 1 == ring->size ? 0 : ring->out + 1;                                  \
+    ring->count--;                                                                                \
+    return 0;                                                                                     \
+}                                                                                                 \
+                                                                                                  \
+static inline Type* Name##Peek(Name* ring) {                                                      \
+    return ring->count > 0 ? &ring->slots[ring->out] : NULL;                                      \
+}                                                                                                 \
+                                                                                                  \
+static inline Type* Name##At(Name* ring, int i) {                                                 \
+    return &ring->slots[(ring->out + i) % ring->size];                                            \
+}                                                                                                 \
+                                                                                                  \
+static inline void Name##Resize(Name* ring, int size) {                                           \
+    Type* slots = malloc(sizeof(Type) * size);                                                    \
+    for (int i = 0; i < ring->count; i++) {                                                       \
+        slots[i] = *Name##At(ring, i);                                                            \
+    }                                                                                             \
+    free(ring->slots);                                                                            \
+    ring->slots = slots;                                                                          \
+    ring->size = size;                                                                            \
+    ring->out = 0;                                                                                \
+    ring->in = ring->count % size;                                                                \
+}
+
+#define DEFINE_STATIC_RING(Name, Type, Capacity)                                                  \
+_Static_assert(((Capacity) & ((Capacity) - 1)) == 0, #Name " capacity must be a power of two");    \
+                                                                                                  \
+typedef struct {                                                                                  \
+    Type slots[Capacity];                                                                         \
+    int size;                                                                                     \
+    int count;                                                                                    \
+    unsigned int in;                                                                              \
+    unsigned int out;                                                                             \
+} Name;                                                                                           \
+                                                                                                  \
+static inline void Name##Init(Name* ring, int size) {                                             \
+    ring->size = size < (Capacity) ? size : (Capacity);                                           \
+    ring->count = 0;                                                                              \
+    ring->in = 0;                                                                                 \
+    ring->out = 0;                                                                                \
+}                                                                                                 \
+                                                                                                  \
+static inline void Name##Destroy(Name* ring) {                                                    \
+}                                                                                                 \
+                                                                                                  \
+static inline int Name##Push(Name* ring, Type item) {                                             \
+    if (ring->count == ring->size) {                                                              \
+        return -1;                                                                                \
+    }                                                                                             \
+    ring->slots[ring->in++ & ((Capacity) - 1)] = item;                                            \
+    ring->count++;                                                                                \
+    return 0;                                                                                     \
+}                                                                                                 \
+                                                                                                  \
+static inline int Name##Pop(Name* ring, Type* item) {                                             \
+    if (ring->count == 0) {                                                                       \
+        return -1;                                                                                \
+    }                                                                                             \
+    *item = ring->slots[ring->out++ & ((Capacity) - 1)];                                          \
+    ring->count--;                                                                                \
+    return 0;                                                                                     \
+}                                                                                                 \
+                                                                                                  \
+static inline Type* Name##Peek(Name* ring) {                                                      \
+    return ring->count > 0 ? &ring->slots[ring->out & ((Capacity) - 1)] : NULL;                   \
+}                                                                                                 \
+                                                                                                  \
+static inline Type* Name##At(Name* ring, int i) {                                                 \
+    return &ring->slots[(ring->out + i) & ((Capacity) - 1)];                                      \
+}                                                                                                 \
+                                                                                                  \
+static inline void Name##Resize(Name* ring, int size) {                                           \
+    ring->size = size < (Capacity) ? size : (Capacity);                                           \
+}
+
+#define DEFINE_QUEUE(Name, Type)                                                                  \
+DEFINE_RING(Name##Ring, Type)                                                                     \
+                                                                                                  \
+typedef struct {                                                                                  \
+    Name##Ring ring;                                                                              \
+    CACHE_ALIGNED sem_t mutex;                                                                    \
+    CACHE_ALIGNED sem_t empty;                                                                    \
+    WaitState emptyWait;                                                                          \
+    CACHE_ALIGNED sem_t full;                                                                     \
+    WaitState fullWait;                                                                           \
+} CACHE_ALIGNED Name;                                                                             \
+                                                                                                  \
+static inline void Name##Init(Name* queue, int size) {                                            \
+    Name##RingInit(&queue->ring, size);                                                           \
+    sem_init(&queue->mutex, 0, 1);                                                                \
+    sem_init(&queue->empty, 0, size);                                                             \
+    sem_init(&queue->full, 0, 0);                                                                 \
+    initWaitState(&queue->emptyWait);                                                             \
+    initWaitState(&queue->fullWait);                                                              \
+}                                                                                                 \
+                                                                                                  \
+static inline void Name##Destroy(Name* queue) {                                                   \
+    Name##RingDestroy(&queue->ring);                                                              \
+    sem_destroy(&queue->mutex);                                                                   \
+    sem_destroy(&queue->empty);                                                                   \
+    sem_destroy(&queue->full);                                                                    \
+}                                                                                                 \
+                                                                                                  \
+/* moves up to n items in or out: takes the slots with acquireSlots, and moves all the items      \
+   under a single lock */                                                                         \
+static inline int Name##Transfer(Name* queue, Type* items, int n, int pushing, long timeoutMs) {  \
+    sem_t* give = pushing ? &queue->full : &queue->empty;                                         \
+    int moved = pushing ? acquireSlots(&queue->empty, &queue->emptyWait, n, timeoutMs)            \
+                        : acquireSlots(&queue->full, &queue->fullWait, n, timeoutMs);             \
+    if (moved == 0) {                                                                             \
+        return 0;                                                                                 \
+    }                                                                                             \
+    sem_wait(&queue->mutex);                                                                      \
+    for (int i = 0; i < moved; i++) {                                                             \
+        if (pushing) {                                                                            \
+            Name##RingPush(&queue->ring, items[i]);                                               \
+        } else {                                                                                  \
+            Name##RingPop(&queue->ring, &items[i]);                                               \
+        }                                                                                         \
+    }                                                                                             \
+    sem_post(&queue->mutex);                                                                      \
+    for (int i = 0; i < moved; i++) {                                                             \
+        sem_post(give);                                                                           \
+    }                                                                                             \
+    return moved;                                                                                 \
+}                                                                                                 \
+                                                                                                  \
+static inline void Name##Push(Name* queue, Type item) {                                           \
+    Name##Transfer(queue, &item, 1, 1, -1);                                                       \
+}                                                                                                 \
+                                                                                                  \
+static inline int Name##TryPush(Name* queue, Type item) {                                         \
+    return Name##Transfer(queue, &item, 1, 1, 0);                                                 \
+}                                                                                                 \
+                                                                                                  \
+static inline int Name##TimedPush(Name* queue, Type item, long timeoutMs) {                       \
+    return Name##Transfer(queue, &item, 1, 1, timeoutMs);                                         \
+}                                                                                                 \
+                                                                                                  \
+static inline void Name##PushBatch(Name* queue, const Type* items, int n) {                       \
+    for (int pushed = 0; pushed < n;) {                                                           \
+        pushed += Name##Transfer(queue, (Type*)items + pushed, n - pushed, 1, -1);                \
+    }                                                                                             \
+}                                                                                                 \
+                                                                                                  \
+static inline int Name##Pop(Name* queue, Type* item) {                                            \
+    return Name##Transfer(queue, item, 1, 0, -1);                                                 \
+}                                                                                                 \
+                                                                                                  \
+static inline int Name##TryPop(Name* queue, Type* item) {                                         \
+    return Name##Transfer(queue, item, 1, 0, 0);                                                  \
+}                                                                                                 \
+                                                                                                  \
+static inline int Name##TimedPop(Name* queue, Type* item, long timeoutMs) {                       \
+    return Name##Transfer(queue, item, 1, 0, timeoutMs);                                          \
+}                                                                                                 \
+                                                                                                  \
+static inline int Name##PopBatch(Name* queue, Type* items, int max) {                             \
+    return Name##Transfer(queue, items, max, 0, -1);                                              \
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include "ReorderBuffer.h"
+
+/**
+ * Initializes a reorder buffer.
+ *
+ * @param reorder      Pointer to the ReorderBuffer to be initialized.
+ * @param numProducers The number of producers.
+ * @param window       The maximal number of articles held per producer.
+ */
+void initReorderBuffer(ReorderBuffer* reorder, int numProducers, int window) {
+    reorder->window = window;
+    reorder->numProducers = numProducers;
+    reorder->slots = calloc((size_t)numProducers * window, sizeof(Article*));
+    reorder->next = calloc(numProducers, sizeof(int));
+    reorder->held = calloc(numProducers, sizeof(int));
+    reorder->occupancy = 0;
+    reorder->maxOccupancy = 0;
+    reorder->occupancySum = 0;
+    reorder->inserted = 0;
+    reorder->reordered = 0;
+    reorder->skipped = 0;
+}
+
+/**
+ * Emits the held articles of a producer that are next in order.
+ */
+static void drainInOrder(ReorderBuffer* reorder, int producer, void (*emit)(Article*)) {
+    Article** slots = reorder->slots + (size_t)producer * reorder->window;
+    while (reorder->held[producer] > 0) {
+        Article** slot = &slots[reorder->next[producer] % reorder->window];
+        if (*slot == NULL) {
+            return;
+        }
+        emit(*slot);
+        *slot = NULL;
+        reorder->held[producer]--;
+        reorder->occupancy--;
+        reorder->next[producer]++;
+    }
+}
+
+/**
+ * Makes room for producers added while the system runs. The slots are grouped by producer, so the
+ * new producers' slots go at the end.
+ */
+static void growReorderBuffer(ReorderBuffer* reorder, int numProducers) {
+    size_t oldSlots = (size_t)reorder->numProducers * reorder->window;
+    size_t newSlots = (size_t)numProducers * reorder->window;
+    reorder->slots = realloc(reorder->slots, newSlots * sizeof(Article*));
+    memset(reorder->slots + oldSlots, 0, (newSlots - oldSlots) * sizeof(Article*));
+    reorder->next = realloc(reorder->next, numProducers * sizeof(int));
+    reorder->held = realloc(reorder->held, numProducers * sizeof(int));
+    for (int i = reorder->numProducers; i < numProducers; i++) {
+        reorder->next[i] = 0;
+        reorder->held[i] = 0;
+    }
+    reorder->numProducers = numProducers;
+}
+
+/**
+ * Passes an article through the reorder buffer: it is emitted right away if it is the next one of
+ * its producer (followed by the held articles it unblocks), and held otherwise.
+ *
+ * @param reorder Pointer to the ReorderBuffer.
+ * @param article The article, with its producer and sequence number set.
+ * @param emit    Called with every article, in order.
+ */
+void reorderInsert(ReorderBuffer* reorder, Article* article, void (*emit)(Article*)) {
+    int producer = article->producer;
+    int seq = article->seq;
+    reorder->inserted++;
+    if (producer >= reorder->numProducers) {
+        growReorderBuffer(reorder, producer + 1);
+    }
+
+    // an article we already gave up on, or one we can't order
+    if (producer < 0 || producer >= reorder->numProducers || seq < reorder->next[producer]) {
+        emit(article);
+        return;
+    }
+
+    // too far ahead: give up on the missing sequence numbers until the article fits the window
+    while (seq >= reorder->next[producer] + reorder->window) {
+        if (reorder->held[producer] == 0) {
+            reorder->skipped += seq - reorder->window + 1 - reorder->next[producer];
+            reorder->next[producer] = seq - reorder->window + 1;
+            break;
+        }
+        Article** slots = reorder->slots + (size_t)producer * reorder->window;
+        if (slots[reorder->next[producer] % reorder->window] == NULL) {
+            reorder->skipped++;
+            reorder->next[producer]++;
+        }
+        drainInOrder(reorder, producer, emit);
+    }
+
+    if (seq == reorder->next[producer]) {
+        emit(article);
+        reorder->next[producer]++;
+        drainInOrder(reorder, producer, emit);
+    } else {
+        reorder->slots[(size_t)producer * reorder->window + seq % reorder->window] = article;
+        reorder->held[producer]++;
+        reorder->occupancy++;
+        reorder->reordered++;
+        if (reorder->occupancy > reorder->maxOccupancy) {
+            reorder->maxOccupancy = reorder->occupancy;
+        }
+    }
+    reorder->occupancySum += reorder->occupancy;
+}
+
+/**
+ * Emits all the held articles, in order, skipping the missing ones.
+ *
+ * @param reorder Pointer to the ReorderBuffer.
+ * @param emit    Called with every article, in order.
+ */
+void reorderFlush(ReorderBuffer* reorder, void (*emit)(Article*)) {
+    for (int producer = 0; producer < reorder->numProducers; producer++) {
+        while (reorder->held[producer] > 0) {
+            drainInOrder(reorder, producer, emit);
+            if (reorder->held[producer] > 0) {
+                reorder->skipped++;
+                reorder->next[producer]++;
+            }
+        }
+    }
+}
+
+/**
+ * Prints the occupancy metrics of the reorder buffer.
+ *
+ * @param reorder Pointer to the ReorderBuffer.
+ * @param out     The stream to print to.
+ */
+void printReorderStats(ReorderBuffer* reorder, FILE* out) {
+    fprintf(out, "Reorder buffer: window %d, articles %ld, reordered %ld, skipped %ld, "
+                 "max occupancy %ld, average occupancy %.2f\n",
+            reorder->window, reorder->inserted, reorder->reordered, reorder->skipped, reorder->maxOccupancy,
+            reorder->inserted > 0 ? (double)reorder->occupancySum / reorder->inserted : 0.0);
+}
+
+/**
+ * Frees the resources of a reorder buffer. It must have been flushed.
+ *
+ * @param reorder Pointer to the ReorderBuffer.
+ */
+void destroyReorderBuffer(ReorderBuffer* reorder) {
+    free(reorder->slots);
+    free(reorder->next);
+    free(reorder->held);
+}
@@ -0,0 +1,42 @@
+#ifndef REORDERBUFFER_H
+#define REORDERBUFFER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Article/Article.h"
+
+/**
+ * Restores the per-producer order of articles by their sequence numbers, holding at most "window"
+ * out-of-order articles per producer. When an article arrives too far ahead of the next expected one,
+ * the missing sequence numbers are given up on (the articles were dropped upstream), so the buffer
+ * never blocks the pipeline. Used by a single thread, so it has no locking.
+ */
+typedef struct {
+    int window;
+    int numProducers;
+    Article** slots;   // window slots per producer, indexed by seq % window
+    int* next;         // the next sequence number expected from each producer
+    int* held;         // the number of articles held for each producer
+
+    // metrics
+    long occupancy;    // articles currently held
+    long maxOccupancy;
+    long occupancySum; // summed over every insertion, for the average
+    long inserted;
+    long reordered;    // articles that had to wait for an earlier one
+    long skipped;      // sequence numbers given up on
+} ReorderBuffer;
+
+void initReorderBuffer(ReorderBuffer* reorder, int numProducers, int window);
+
+void reorderInsert(ReorderBuffer* reorder, Article* article, void (*emit)(Article*));
+
+void reorderFlush(ReorderBuffer* reorder, void (*emit)(Article*));
+
+void printReorderStats(ReorderBuffer* reorder, FILE* out);
+
+void destroyReorderBuffer(ReorderBuffer* reorder);
+
+#endif
@@ -0,0 +1,242 @@
+#include "Replay.h"
+
+/**
+ * The record/replay harness for performance comparisons. With RECORD or REPLAY, every article is
+ * numbered (like the audit does) and the time it reaches each stage is recorded. At the end, a
+ * report gives the throughput and the latency between the stages; RECORD also writes the arrivals
+ * (the input schedule) and the stage events to a file, which REPLAY sends again on the same schedule
+ * (see loadRecording), so two builds can be compared on the same input.
+ */
+typedef struct {
+    int enabled;
+    sem_t mutex; // protects the arrivals and the events
+    Arrival* arrivals;
+    long numArrivals;
+    long arrivalsCapacity;
+    StageEvent* events;
+    long numEvents;
+    long eventsCapacity;
+} Recorder;
+
+static Recorder recorder;
+
+static const char* stageNames[NUM_STAGES] = {"produced", "dispatched", "edited", "displayed"};
+
+/**
+ * Starts recording, when RECORD or REPLAY is set. Must be called before the producers start.
+ */
+void startRecording() {
+    if (config.recordPath == NULL && config.replayPath == NULL) {
+        return;
+    }
+    sem_init(&recorder.mutex, 0, 1);
+    recorder.arrivalsCapacity = 1024;
+    recorder.arrivals = malloc(sizeof(Arrival) * recorder.arrivalsCapacity);
+    recorder.numArrivals = 0;
+    recorder.eventsCapacity = 4096;
+    recorder.events = malloc(sizeof(StageEvent) * recorder.eventsCapacity);
+    recorder.numEvents = 0;
+    recorder.enabled = 1;
+}
+
+/**
+ * Records an article entering its producer's queue. Called by the producers, before the insertion.
+ *
+ * @param article The produced article, already numbered (see auditProduced).
+ */
+void recordArrival(const Article* article) {
+    if (!recorder.enabled || article->auditId == 0) {
+        return;
+    }
+    // a rate-controlled article arrives at its intended send time, even if it was sent late
+    long arrivedNs = article->intendedNs != 0 ? article->intendedNs : monotonicNs();
+    Arrival arrival = {.number = article->auditId, .producer = article->producer, .priority = article->priority,
+                       .offsetNs = arrivedNs - loadStartTime(), .text = strdup(article->text)};
+    sem_wait(&recorder.mutex);
+    if (recorder.numArrivals == recorder.arrivalsCapacity) {
+        recorder.arrivalsCapacity *= 2;
+        recorder.arrivals = realloc(recorder.arrivals, sizeof(Arrival) * recorder.arrivalsCapacity);
+    }
+    recorder.arrivals[recorder.numArrivals++] = arrival;
+    sem_post(&recorder.mutex);
+    recordStage(article, STAGE_PRODUCED);
+}
+
+/**
+ * Records an article reaching a stage.
+ *
+ * @param article The article.
+ * @param stage   The stage.
+ */
+void recordStage(const Article* article, Stage stage) {
+    if (!recorder.enabled || article->auditId == 0) {
+        return;
+    }
+    StageEvent event = {.number = article->auditId, .stage = stage, .offsetNs = monotonicNs() - loadStartTime()};
+    sem_wait(&recorder.mutex);
+    if (recorder.numEvents == recorder.eventsCapacity) {
+        recorder.eventsCapacity *= 2;
+        recorder.events = realloc(recorder.events, sizeof(StageEvent) * recorder.eventsCapacity);
+    }
+    recorder.events[recorder.numEvents++] = event;
+    sem_post(&recorder.mutex);
+}
+
+static int compareArrivals(const void* a, const void* b) {
+    long first = ((const Arrival*)a)->offsetNs, second = ((const Arrival*)b)->offsetNs;
+    return first < second ? -1 : first > second;
+}
+
+static int compareLongs(const void* a, const void* b) {
+    long first = *(const long*)a, second = *(const long*)b;
+    return first < second ? -1 : first > second;
+}
+
+/**
+ * Reads the arrivals of a file written by RECORD, in the order they arrived.
+ *
+ * @param path     The recording.
+ * @param arrivals Set to a malloc'd array of the arrivals (their texts are malloc'd too).
+ * @return The number of arrivals, or -1 if the recording can't be read.
+ */
+int loadRecording(const char* path, Arrival** arrivals) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening recording %s.\n", path);
+        return -1;
+    }
+    int count = 0, capacity = 1024;
+    *arrivals = malloc(sizeof(Arrival) * capacity);
+    char* line = NULL;
+    size_t len = 0;
+    ssize_t length;
+    while ((length = getline(&line, &len, file)) != -1) {
+        if (length > 0 && line[length - 1] == '\n') {
+            line[--length] = '\0';
+        }
+        Arrival arrival;
+        unsigned long long number;
+        int textStart = 0;
+        // "ARRIVAL <number> <producer> <offset ns> <priority> <text>", the text follows a single
+        // space and keeps its own leading blanks
+        if (sscanf(line, "ARRIVAL %llu %d %ld %d%n", &number, &arrival.producer, &arrival.offsetNs,
+                   &arrival.priority, &textStart) != 4 || textStart == 0 || line[textStart] != ' ') {
+            continue;
+        }
+        textStart++;
+        if (count == capacity) {
+            capacity *= 2;
+            *arrivals = realloc(*arrivals, sizeof(Arrival) * capacity);
+        }
+        arrival.number = number;
+        arrival.text = strdup(line + textStart);
+        (*arrivals)[count++] = arrival;
+    }
+    free(line);
+    fclose(file);
+    qsort(*arrivals, count, sizeof(Arrival), compareArrivals);
+    return count;
+}
+
+/**
+ * Prints the percentiles of the latencies between two stages.
+ */
+static void reportLatency(FILE* out, const char* from, const char* to, long* latencies, long count) {
+    if (count == 0) {
+        return;
+    }
+    qsort(latencies, count, sizeof(long), compareLongs);
+    fprintf(out, "Stages: %s -> %s: articles %ld, p50 %.2fms, p90 %.2fms, p99 %.2fms, max %.2fms\n", from, to,
+            count, latencies[(count - 1) / 2] / 1e6, latencies[(count - 1) * 9 / 10] / 1e6,
+            latencies[(count - 1) * 99 / 100] / 1e6, latencies[count - 1] / 1e6);
+}
+
+/**
+ * Writes the recording (with RECORD) and reports the throughput and the latency between the stages.
+ * No thread may record anymore.
+ *
+ * @param report Where to write the report.
+ * @return 0 on success, -1 if the recording can't be written.
+ */
+int finishRecording(FILE* report) {
+    if (!recorder.enabled) {
+        return 0;
+    }
+    recorder.enabled = 0;
+    int result = 0;
+    qsort(recorder.arrivals, recorder.numArrivals, sizeof(Arrival), compareArrivals);
+    if (config.recordPath != NULL) {
+        FILE* file = fopen(config.recordPath, "w");
+        if (file == NULL) {
+            fprintf(stderr, "Error creating recording %s.\n", config.recordPath);
+            result = -1;
+        } else {
+            for (long i = 0; i < recorder.numArrivals; i++) {
+                Arrival* arrival = &recorder.arrivals[i];
+                fprintf(file, "ARRIVAL %llu %d %ld %d %s\n", (unsigned long long)arrival->number, arrival->producer,
+                        arrival->offsetNs, arrival->priority, arrival->text);
+            }
+            for (long i = 0; i < recorder.numEvents; i++) {
+                StageEvent* event = &recorder.events[i];
+                fprintf(file, "STAGE %llu %s %ld\n", (unsigned long long)event->number, stageNames[event->stage],
+                        event->offsetNs);
+            }
+            if (fclose(file) != 0) {
+                result = -1;
+            }
+        }
+    }
+
+    // the time every numbered article reached every stage (-1 if it didn't)
+    uint64_t maxNumber = 0;
+    long first = -1, last = 0, displayed = 0;
+    for (long i = 0; i < recorder.numEvents; i++) {
+        StageEvent* event = &recorder.events[i];
+        if (event->number > maxNumber) {
+            maxNumber = event->number;
+        }
+        if (first < 0 || event->offsetNs < first) {
+            first = event->offsetNs;
+        }
+        if (event->stage == STAGE_DISPLAYED) {
+            displayed++;
+            if (event->offsetNs > last) {
+                last = event->offsetNs;
+            }
+        }
+    }
+    long* times = malloc(sizeof(long) * (maxNumber + 1) * NUM_STAGES);
+    memset(times, 0xff, sizeof(long) * (maxNumber + 1) * NUM_STAGES);
+    for (long i = 0; i < recorder.numEvents; i++) {
+        times[recorder.events[i].number * NUM_STAGES + recorder.events[i].stage] = recorder.events[i].offsetNs;
+    }
+    double seconds = displayed > 0 ? (last - first) / 1e9 : 0;
+    fprintf(report, "Stages: %ld articles displayed in %.3fs, %.1f articles/s\n", displayed, seconds,
+            seconds > 0 ? displayed / seconds : 0);
+
+    // the latency of every pair of successive stages, and end to end; the copies of an article routed
+    // to several categories never entered a producer's queue, and are left out
+    long* latencies = malloc(sizeof(long) * (maxNumber + 1));
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        int from = stage < NUM_STAGES - 1 ? stage : STAGE_PRODUCED;
+        int to = stage < NUM_STAGES - 1 ? stage + 1 : STAGE_DISPLAYED;
+        long count = 0;
+        for (uint64_t number = 1; number <= maxNumber; number++) {
+            long start = times[number * NUM_STAGES + from], end = times[number * NUM_STAGES + to];
+            if (times[number * NUM_STAGES + STAGE_PRODUCED] >= 0 && start >= 0 && end >= 0) {
+                latencies[count++] = end - start;
+            }
+        }
+        reportLatency(report, stageNames[from], stageNames[to], latencies, count);
+    }
+    free(latencies);
+    free(times);
+
+    for (long i = 0; i < recorder.numArrivals; i++) {
+        free(recorder.arrivals[i].text);
+    }
+    free(recorder.arrivals);
+    free(recorder.events);
+    sem_destroy(&recorder.mutex);
+    return result;
+}
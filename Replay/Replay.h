@@ -0,0 +1,49 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <semaphore.h>
+
+#include "../Config/Config.h"
+#include "../Article/Article.h"
+#include "../LoadGenerator/LoadGenerator.h"
+
+// The points of the pipeline an article's progress is recorded at.
+typedef enum {
+    STAGE_PRODUCED,   // entering its producer's queue
+    STAGE_DISPATCHED, // leaving the dispatcher for its category queue
+    STAGE_EDITED,     // leaving its co-editor
+    STAGE_DISPLAYED,  // displayed by the screen manager
+    NUM_STAGES
+} Stage;
+
+// An article entering the system, as recorded: enough to send it again at the same time.
+typedef struct {
+    uint64_t number;
+    int producer;
+    int priority;
+    long offsetNs; // since the start of the load
+    char* text;
+} Arrival;
+
+// An article reaching a stage.
+typedef struct {
+    uint64_t number;
+    Stage stage;
+    long offsetNs;
+} StageEvent;
+
+void startRecording();
+
+void recordArrival(const Article* article);
+
+void recordStage(const Article* article, Stage stage);
+
+int loadRecording(const char* path, Arrival** arrivals);
+
+int finishRecording(FILE* report);
+
+#endif
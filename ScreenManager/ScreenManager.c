@@ -1,19 +1,88 @@
 #include "ScreenManager.h"
+#include "../globals.h"
+
+// with COMPRESSED_OUTPUT, the displayed articles go to a compressed file instead of the screen
+static CompressedWriter output;
+static int compressedOutput = 0;
+
+/**
+ * Prints an article to the screen (or appends it to the compressed output) and frees it.
+ *
+ * @param article The article to display.
+ */
+static void display(Article* article) {
+    if (compressedOutput) {
+        compressedWrite(&output, article->text, strlen(article->text));
+        compressedWrite(&output, "\n", 1);
+    } else {
+        printf("%s\n", article->text);
+    }
+    recordLatency(article);
+    recordStage(article, STAGE_DISPLAYED);
+    auditDisplayed(article);
+    if (config.journalPath != NULL) {
+        // the article is only published once it left our stdio buffer
+        fflush(stdout);
+        journalPublish(article);
+    }
+    freeArticle(article);
+}
 
 /**
  * Manages the screen display.
  * Continuously retrieves messages from the shared buffer and prints them to the screen.
  * Keeps track of the number of "DONE" messages received to determine when to exit the loop.
+ * In the ordered output mode, the articles of every producer pass through a reorder buffer,
+ * so they are printed in the order the producer created them.
+ *
+ * @param arg Unused.
+ * @return NULL when all the co-editors are done.
  */
-void screenManager() {
+void* screenManager(void* arg) {
     int doneCounter = 0;
+    TRACE_THREAD("screen manager", 0);
+    if (config.outputPath != NULL) {
+        // a journaled article is published once it is on the screen, not in a batch still to compress
+        if (config.journalPath != NULL) {
+            fprintf(stderr, "COMPRESSED_OUTPUT can't be used with JOURNAL, displaying on the screen.\n");
+        } else {
+            compressedOutput = openCompressedWriter(&output, config.outputPath) == 0;
+        }
+    }
+    ReorderBuffer reorder;
+    if (config.orderedWindow > 0) {
+        sem_wait(&producersMutex);
+        initReorderBuffer(&reorder, numProducers, config.orderedWindow);
+        sem_post(&producersMutex);
+    }
 
-    while (doneCounter < 3) {
-        char *message = removeBounded(sharedBuffer);
-        if (strcmp(message, "DONE") == 0) {
+    while (doneCounter < NUM_CO_EDITORS) {
+        Article* article = removeBounded(sharedBuffer);
+        jitter();
+        if (isDone(article)) {
             doneCounter++;
+            freeArticle(article);
             continue;
         }
-        printf("%s\n", message);
+        if (config.orderedWindow > 0) {
+            reorderInsert(&reorder, article, display);
+        } else {
+            display(article);
+        }
+    }
+
+    if (config.orderedWindow > 0) {
+        reorderFlush(&reorder, display);
+        printReorderStats(&reorder, stderr);
+        destroyReorderBuffer(&reorder);
+    }
+    if (compressedOutput) {
+        if (closeCompressedWriter(&output) != 0) {
+            perror(config.outputPath);
+        }
+        fprintf(stderr, "Output: compressed %ld bytes to %ld\n", output.rawBytes, output.storedBytes);
+        compressedOutput = 0;
     }
-}
\ No newline at end of file
+    printLoadReport(stderr);
+    return NULL;
+}
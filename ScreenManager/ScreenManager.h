@@ -2,9 +2,15 @@
 #define SCREENMANAGER_H
 
 #include <stdio.h>
+#include <string.h>
 
 #include "../BoundedBuffer/BoundedBuffer.h"
+#include "../ReorderBuffer/ReorderBuffer.h"
+#include "../LoadGenerator/LoadGenerator.h"
+#include "../Journal/Journal.h"
+#include "../Stress/Stress.h"
+#include "../Compress/Compress.h"
 
-void screenManager();
+void* screenManager(void* arg);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,203 @@
+#include "ShmRing.h"
+
+static int slotsFor(int capacity) {
+    return capacity > SHM_MIN_SLOTS ? capacity : SHM_MIN_SLOTS;
+}
+
+static size_t ringSize(int capacity) {
+    return sizeof(ShmRing) + sizeof(ShmSlot) * NUM_PRIORITIES * slotsFor(capacity);
+}
+
+/**
+ * Creates a shared memory segment holding an empty ring, and maps it.
+ *
+ * @param name     The name of the segment ("/something").
+ * @param capacity The number of articles the ring holds.
+ * @return The mapped ring, or NULL if the segment can't be created.
+ */
+ShmRing* createShmRing(const char* name, int capacity) {
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+    size_t size = ringSize(capacity);
+    if (ftruncate(fd, size) != 0) {
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    ShmRing* ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // the mapping keeps the segment alive
+    close(fd);
+    if (ring == MAP_FAILED) {
+        perror("mmap");
+        shm_unlink(name);
+        return NULL;
+    }
+
+    ring->capacity = capacity;
+    ring->numSlots = slotsFor(capacity);
+    ring->count = 0;
+    ring->served = 0;
+    ring->truncated = 0;
+    for (int lane = 0; lane < NUM_PRIORITIES; lane++) {
+        ring->laneCount[lane] = 0;
+        ring->in[lane] = 0;
+        ring->out[lane] = 0;
+    }
+    // pshared = 1: the semaphores are used by every process mapping the segment
+    sem_init(&ring->mutex, 1, 1);
+    sem_init(&ring->empty, 1, capacity);
+    sem_init(&ring->room, 1, ring->numSlots);
+    sem_init(&ring->spanning, 1, 1);
+    sem_init(&ring->full, 1, 0);
+    initWaitState(&ring->emptyWait);
+    initWaitState(&ring->roomWait);
+    initWaitState(&ring->fullWait);
+    return ring;
+}
+
+/**
+ * Copies an article into the lane of its priority, over as many slots as its text needs, waiting
+ * while the ring is full. The caller keeps ownership of the article.
+ *
+ * @param ring    The ring.
+ * @param article The article to copy.
+ */
+void shmRingPush(ShmRing* ring, const Article* article) {
+    size_t length = strlen(article->text);
+    int span = length > SHM_TEXT_SIZE ? (length + SHM_TEXT_SIZE - 1) / SHM_TEXT_SIZE : 1;
+    int truncated = span > ring->numSlots;
+    if (truncated) {
+        span = ring->numSlots;
+        length = (size_t)span * SHM_TEXT_SIZE;
+    }
+    acquireSlots(&ring->empty, &ring->emptyWait, 1, -1);
+    if (span == 1) {
+        acquireSlots(&ring->room, &ring->roomWait, 1, -1);
+    } else {
+        // two articles each holding part of the slots they need could wait for each other forever
+        sem_wait(&ring->spanning);
+        for (int taken = 0; taken < span;) {
+            taken += acquireSlots(&ring->room, &ring->roomWait, span - taken, -1);
+        }
+        sem_post(&ring->spanning);
+    }
+    sem_wait(&ring->mutex);
+
+    int lane = article->priority;
+    ShmSlot* slot = &ring->slots[lane * ring->numSlots + ring->in[lane]];
+    if (truncated && ring->truncated++ == 0) {
+        fprintf(stderr, "An article of %zu bytes doesn't fit in a ring of %d slots, truncating it to %zu bytes.\n",
+                strlen(article->text), ring->numSlots, length);
+    }
+    for (int i = 0; i < span; i++) {
+        size_t offset = (size_t)i * SHM_TEXT_SIZE;
+        size_t chunk = length - offset < SHM_TEXT_SIZE ? length - offset : SHM_TEXT_SIZE;
+        memcpy(ring->slots[lane * ring->numSlots + ring->in[lane]].text, article->text + offset, chunk);
+        ring->in[lane] = (ring->in[lane] + 1) % ring->numSlots;
+    }
+    slot->length = length;
+    slot->span = span;
+    slot->priority = article->priority;
+    slot->done = article->done;
+    slot->producer = article->producer;
+    slot->seq = article->seq;
+    slot->intendedNs = article->intendedNs;
+    slot->id = article->id;
+    slot->auditId = article->auditId;
+    ring->laneCount[lane]++;
+    ring->count++;
+
+    sem_post(&ring->mutex);
+    sem_post(&ring->full);
+}
+
+/**
+ * Takes the next article out of the ring, serving the priority lanes in order (see selectLane).
+ * The caller already holds one of the full slots.
+ */
+static Article* takeSlot(ShmRing* ring) {
+    sem_wait(&ring->mutex);
+
+    // selectLane only checks whether the heads are "DONE", mirror the slots in stack articles
+    Article headArticles[NUM_PRIORITIES];
+    Article* heads[NUM_PRIORITIES];
+    for (int lane = 0; lane < NUM_PRIORITIES; lane++) {
+        heads[lane] = NULL;
+        if (ring->laneCount[lane] > 0) {
+            headArticles[lane].done = ring->slots[lane * ring->numSlots + ring->out[lane]].done;
+            heads[lane] = &headArticles[lane];
+        }
+    }
+    int lane = selectLane(ring->laneCount, heads, &ring->served);
+    ShmSlot* slot = &ring->slots[lane * ring->numSlots + ring->out[lane]];
+    int span = slot->span;
+    Article* article;
+    if (span == 1) {
+        article = newArticleFromBytes(slot->text, slot->length, slot->priority);
+    } else {
+        // gather the text from the slots it continues in
+        char* text = malloc(slot->length);
+        for (int i = 0; i < span; i++) {
+            size_t offset = (size_t)i * SHM_TEXT_SIZE;
+            size_t chunk = slot->length - offset < SHM_TEXT_SIZE ? slot->length - offset : SHM_TEXT_SIZE;
+            int index = (ring->out[lane] + i) % ring->numSlots;
+            memcpy(text + offset, ring->slots[lane * ring->numSlots + index].text, chunk);
+        }
+        article = newArticleFromBytes(text, slot->length, slot->priority);
+        free(text);
+    }
+    article->done = slot->done;
+    article->producer = slot->producer;
+    article->seq = slot->seq;
+    article->intendedNs = slot->intendedNs;
+    article->id = slot->id;
+    article->auditId = slot->auditId;
+    ring->out[lane] = (ring->out[lane] + span) % ring->numSlots;
+    ring->laneCount[lane]--;
+    ring->count--;
+
+    sem_post(&ring->mutex);
+    for (int i = 0; i < span; i++) {
+        sem_post(&ring->room);
+    }
+    sem_post(&ring->empty);
+    return article;
+}
+
+/**
+ * Removes an article, serving the priority lanes in order (see selectLane), waiting while the ring
+ * is empty (see acquireSlots).
+ *
+ * @param ring      The ring.
+ * @param timeoutMs The longest time to wait, in milliseconds: -1 as long as it takes, 0 not at all.
+ * @return A new article, owned by the caller, or NULL if the ring stayed empty.
+ */
+Article* shmRingPop(ShmRing* ring, long timeoutMs) {
+    if (acquireSlots(&ring->full, &ring->fullWait, 1, timeoutMs) == 0) {
+        return NULL;
+    }
+    return takeSlot(ring);
+}
+
+/**
+ * Unmaps a ring and removes its segment. The other processes may keep their own mappings.
+ *
+ * @param ring The ring.
+ * @param name The name it was created with.
+ */
+void destroyShmRing(ShmRing* ring, const char* name) {
+    if (ring->truncated > 0) {
+        fprintf(stderr, "%s: truncated %ld articles longer than the ring\n", name, ring->truncated);
+    }
+    sem_destroy(&ring->mutex);
+    sem_destroy(&ring->empty);
+    sem_destroy(&ring->room);
+    sem_destroy(&ring->spanning);
+    sem_destroy(&ring->full);
+    munmap(ring, ringSize(ring->capacity));
+    shm_unlink(name);
+}
@@ -0,0 +1,78 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <semaphore.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../cacheline.h"
+#include "../Article/Article.h"
+#include "../WaitStrategy/WaitStrategy.h"
+
+// the article text a slot holds, a longer text continues in the next slots of the lane
+#define SHM_TEXT_SIZE 512
+// the fewest slots of a lane, so a ring of a few articles still takes texts of up to 64 KB
+#define SHM_MIN_SLOTS 128
+
+// an article stored inline in a slot (its first one), so it can cross the process boundary
+typedef struct {
+    int32_t length; // of the whole text, which isn't null terminated
+    int16_t priority;
+    int16_t done;
+    int32_t producer;
+    int32_t seq;
+    int32_t span; // the slots the article takes: this one and the continuations of its text
+    int64_t intendedNs;
+    uint64_t id;
+    uint64_t auditId;
+    char text[SHM_TEXT_SIZE];
+} ShmSlot;
+
+/**
+ * A bounded ring of articles in POSIX shared memory, connecting stages that run as separate
+ * processes. Like the BoundedBuffer it has a FIFO ring per priority lane sharing one capacity, and it
+ * signals with process-shared semaphores. Articles are copied into the slots, so no pointer ever
+ * crosses the process boundary. The segment is named, so another process can map it by name.
+ *
+ * The capacity counts articles, the slots are a pool of their own: a text longer than a slot takes
+ * consecutive slots of its lane, and one longer than all the slots is truncated to them (with a
+ * warning).
+ */
+typedef struct {
+    int capacity;
+    int numSlots; // the slots of every lane, and of all of them together
+
+    CACHE_ALIGNED sem_t mutex;
+    int count;
+    int laneCount[NUM_PRIORITIES];
+    int in[NUM_PRIORITIES];
+    int out[NUM_PRIORITIES];
+    int served;
+    long truncated; // articles whose text didn't fit in the ring
+
+    CACHE_ALIGNED sem_t empty;
+    WaitState emptyWait;
+    sem_t room; // the free slots
+    WaitState roomWait;
+    sem_t spanning; // held while an article takes several slots
+
+    CACHE_ALIGNED sem_t full;
+    WaitState fullWait;
+
+    CACHE_ALIGNED ShmSlot slots[]; // NUM_PRIORITIES rings of numSlots slots
+} ShmRing;
+
+ShmRing* createShmRing(const char* name, int capacity);
+
+void shmRingPush(ShmRing* ring, const Article* article);
+
+Article* shmRingPop(ShmRing* ring, long timeoutMs);
+
+void destroyShmRing(ShmRing* ring, const char* name);
+
+#endif
@@ -0,0 +1,245 @@
+#include "Spill.h"
+#include "../Config/Config.h"
+
+/**
+ * Initializes an empty spill segment (no file is created until the first spill).
+ *
+ * @param spill Pointer to the Spill to be initialized.
+ */
+void initSpill(Spill* spill) {
+    spill->fd = -1;
+    spill->count = 0;
+    spill->flushedSize = 0;
+    spill->writeBuffer = NULL;
+    spill->writeSize = 0;
+    spill->readOffset = 0;
+    spill->readBuffer = NULL;
+    spill->readSize = 0;
+    spill->readPos = 0;
+    spill->spilled = 0;
+    spill->maxCount = 0;
+    spill->rawBytes = 0;
+    spill->storedBytes = 0;
+}
+
+/**
+ * Creates the (already unlinked) segment file in the spill directory.
+ */
+static int openSegment(Spill* spill) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/spill-XXXXXX", config.spillDir);
+    spill->fd = mkstemp(path);
+    if (spill->fd < 0) {
+        fprintf(stderr, "Error creating spill segment in %s.\n", config.spillDir);
+        return -1;
+    }
+    unlink(path);
+    spill->writeBuffer = malloc(SPILL_BLOCK_SIZE);
+    spill->readBuffer = malloc(SPILL_BLOCK_SIZE);
+    return 0;
+}
+
+/**
+ * Writes the batched records to the segment file (as one compressed frame, with COMPRESS).
+ */
+static int flushWrites(Spill* spill) {
+    if (spill->writeSize == 0) {
+        return 0;
+    }
+    const char* data = spill->writeBuffer;
+    size_t size = spill->writeSize;
+    char* frame = NULL;
+    if (config.compress) {
+        frame = malloc(sizeof(FrameHeader) + COMPRESS_BOUND(spill->writeSize));
+        size = compressFrame(spill->writeBuffer, spill->writeSize, frame);
+        data = frame;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t written = pwrite(spill->fd, data + done, size - done, spill->flushedSize + done);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("spill");
+            free(frame);
+            return -1;
+        }
+        done += written;
+    }
+    free(frame);
+    spill->rawBytes += spill->writeSize;
+    spill->storedBytes += size;
+    spill->flushedSize += size;
+    spill->writeSize = 0;
+    return 0;
+}
+
+/**
+ * Appends an article to the segment, and frees it.
+ *
+ * @param spill   Pointer to the Spill.
+ * @param article The article to spill.
+ * @return 0 on success, -1 if the segment can't be written (the article is left untouched).
+ */
+int spillWrite(Spill* spill, Article* article) {
+    if (spill->fd < 0 && openSegment(spill) != 0) {
+        return -1;
+    }
+    SpillRecord record = {.length = strlen(article->text), .priority = article->priority,
+                          .done = article->done, .producer = article->producer, .seq = article->seq,
+                          .intendedNs = article->intendedNs, .id = article->id,
+                          .auditId = article->auditId};
+    size_t size = sizeof(record) + record.length;
+    if (spill->writeSize + size > SPILL_BLOCK_SIZE && flushWrites(spill) != 0) {
+        return -1;
+    }
+    if (size > SPILL_BLOCK_SIZE) {
+        // an article larger than a block is written on its own
+        spill->writeBuffer = realloc(spill->writeBuffer, size);
+    }
+    memcpy(spill->writeBuffer + spill->writeSize, &record, sizeof(record));
+    memcpy(spill->writeBuffer + spill->writeSize + sizeof(record), article->text, record.length);
+    spill->writeSize += size;
+    if (size > SPILL_BLOCK_SIZE && flushWrites(spill) != 0) {
+        return -1;
+    }
+
+    freeArticle(article);
+    spill->count++;
+    spill->spilled++;
+    if (spill->count > spill->maxCount) {
+        spill->maxCount = spill->count;
+    }
+    return 0;
+}
+
+/**
+ * Reads the next frame of a compressed segment into the read buffer. The frames hold whole records.
+ */
+static int readFrame(Spill* spill) {
+    // the records still batched in memory have to reach the file first
+    if (spill->readOffset >= spill->flushedSize && flushWrites(spill) != 0) {
+        return -1;
+    }
+    FrameHeader header;
+    ssize_t bytesRead;
+    do {
+        bytesRead = pread(spill->fd, &header, sizeof(header), spill->readOffset);
+    } while (bytesRead < 0 && errno == EINTR);
+    if (bytesRead != sizeof(header)) {
+        perror("spill");
+        return -1;
+    }
+    char* frame = malloc(header.size);
+    do {
+        bytesRead = pread(spill->fd, frame, header.size, spill->readOffset + sizeof(header));
+    } while (bytesRead < 0 && errno == EINTR);
+    if (header.length > SPILL_BLOCK_SIZE) {
+        spill->readBuffer = realloc(spill->readBuffer, header.length);
+    }
+    if (bytesRead != (ssize_t)header.size
+        || decompressBlock(frame, header.size, spill->readBuffer, header.length) != 0) {
+        fprintf(stderr, "spill: corrupt frame\n");
+        free(frame);
+        spill->readSize = 0;
+        return -1;
+    }
+    free(frame);
+    spill->readOffset += sizeof(header) + header.size;
+    spill->readSize = header.length;
+    spill->readPos = 0;
+    return 0;
+}
+
+/**
+ * Makes sure the read buffer holds the next "size" bytes of the segment, reading ahead a block.
+ */
+static int fillReadBuffer(Spill* spill, size_t size) {
+    if (spill->readPos + size <= spill->readSize) {
+        return 0;
+    }
+    if (config.compress) {
+        // a record never spans two frames
+        if (spill->readPos < spill->readSize || readFrame(spill) != 0) {
+            return -1;
+        }
+        return spill->readPos + size <= spill->readSize ? 0 : -1;
+    }
+    // the records still batched in memory have to reach the file first
+    if (spill->readOffset + (off_t)(spill->readPos + size) > spill->flushedSize && flushWrites(spill) != 0) {
+        return -1;
+    }
+    spill->readOffset += spill->readPos;
+    spill->readPos = 0;
+    size_t capacity = size > SPILL_BLOCK_SIZE ? size : SPILL_BLOCK_SIZE;
+    if (size > SPILL_BLOCK_SIZE) {
+        spill->readBuffer = realloc(spill->readBuffer, capacity);
+    }
+    ssize_t bytesRead;
+    do {
+        bytesRead = pread(spill->fd, spill->readBuffer, capacity, spill->readOffset);
+    } while (bytesRead < 0 && errno == EINTR);
+    if (bytesRead < (ssize_t)size) {
+        perror("spill");
+        spill->readSize = 0;
+        return -1;
+    }
+    spill->readSize = bytesRead;
+    return 0;
+}
+
+/**
+ * Pages the oldest spilled article back in.
+ *
+ * @param spill Pointer to the Spill, holding at least one article.
+ * @return The article, or NULL if it can't be read back.
+ */
+Article* spillRead(Spill* spill) {
+    SpillRecord record;
+    if (fillReadBuffer(spill, sizeof(record)) != 0) {
+        return NULL;
+    }
+    memcpy(&record, spill->readBuffer + spill->readPos, sizeof(record));
+    if (fillReadBuffer(spill, sizeof(record) + record.length) != 0) {
+        return NULL;
+    }
+    Article* article = newArticleFromBytes(spill->readBuffer + spill->readPos + sizeof(record), record.length,
+                                           record.priority);
+    article->done = record.done;
+    article->producer = record.producer;
+    article->seq = record.seq;
+    article->intendedNs = record.intendedNs;
+    article->id = record.id;
+    article->auditId = record.auditId;
+    spill->readPos += sizeof(record) + record.length;
+    spill->count--;
+
+    // drained: reuse the segment from its start
+    if (spill->count == 0) {
+        if (ftruncate(spill->fd, 0) != 0) {
+            perror("spill");
+        }
+        spill->flushedSize = 0;
+        spill->writeSize = 0;
+        spill->readOffset = 0;
+        spill->readSize = 0;
+        spill->readPos = 0;
+    }
+    return article;
+}
+
+/**
+ * Closes the segment file, dropping the articles still in it.
+ *
+ * @param spill Pointer to the Spill.
+ */
+void destroySpill(Spill* spill) {
+    if (spill->fd >= 0) {
+        close(spill->fd);
+    }
+    free(spill->writeBuffer);
+    free(spill->readBuffer);
+    spill->fd = -1;
+    spill->count = 0;
+}
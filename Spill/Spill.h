@@ -0,0 +1,64 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../Article/Article.h"
+#include "../Compress/Compress.h"
+
+// size of the write batches and of the read-ahead of a spill segment
+#define SPILL_BLOCK_SIZE (64 * 1024)
+
+// the header of an article in a spill segment, followed by its text
+typedef struct {
+    uint32_t length;
+    int16_t priority;
+    int16_t done;
+    int32_t producer;
+    int32_t seq;
+    int64_t intendedNs;
+    uint64_t id;
+    uint64_t auditId;
+} SpillRecord;
+
+/**
+ * An append-only segment file holding the overflow of a queue lane, in FIFO order. Articles are
+ * appended in SPILL_BLOCK_SIZE batches and paged back in sequentially with read-ahead; once the
+ * segment is drained, the file is truncated and reused. The file is created on the first spill and
+ * unlinked right away, so it disappears with the process.
+ * With COMPRESS, every batch is written as a compressed frame (see Compress.h), and read back a
+ * frame at a time.
+ * Not thread safe, the owning queue serializes the calls.
+ */
+typedef struct {
+    int fd;
+    long count;          // articles in the segment that weren't paged back in yet
+    off_t flushedSize;   // bytes of the segment written to the file
+    char* writeBuffer;
+    size_t writeSize;
+    off_t readOffset;    // file offset of readBuffer (of the next frame to read, with COMPRESS)
+    char* readBuffer;
+    size_t readSize;
+    size_t readPos;
+    // statistics
+    long spilled;
+    long maxCount;
+    long rawBytes;       // bytes of the batches written
+    long storedBytes;    // bytes they took in the file
+} Spill;
+
+void initSpill(Spill* spill);
+
+int spillWrite(Spill* spill, Article* article);
+
+Article* spillRead(Spill* spill);
+
+void destroySpill(Spill* spill);
+
+#endif
@@ -0,0 +1,76 @@
+# Generates the header of the specialized build (make static) from a configuration file:
+#
+#   STATIC_CONF            the configuration it was generated from
+#   STATIC_NUM_PRODUCERS   the producers it configures (number triples and INGEST lines)
+#   STATIC_QUEUE_CAPACITY  the smallest power of two that holds its largest bounded queue
+#   STATIC_ROUTES          the routing table: the category names, then the SUBSCRIBE options
+#
+# Usage: awk -f Static/StaticConfig.awk conf.txt > Static/StaticConfig.h
+
+BEGIN {
+    category["SPORTS"] = 0
+    category["NEWS"] = 1
+    category["WEATHER"] = 2
+    numbers = 0
+    producers = 0
+    largest = 1
+    routes = "{\"SPORTS\", 0}, {\"NEWS\", 1}, {\"WEATHER\", 2}"
+}
+
+function fit(size) {
+    if (size + 0 > largest) {
+        largest = size + 0
+    }
+}
+
+# empty lines
+NF == 0 { next }
+
+$1 == "INGEST" {
+    producers++
+    fit($3)
+    next
+}
+
+# the producers replayed by a recovery or a recording have 64 slots
+$1 == "RECOVER" || $1 == "REPLAY" {
+    fit(64)
+    next
+}
+
+$1 == "SUBSCRIBE" {
+    if ($2 in category && NF >= 3) {
+        keyword = $3
+        gsub(/[\\"]/, "\\\\&", keyword)
+        routes = routes sprintf(", {\"%s\", %d}", keyword, category[$2])
+    }
+    next
+}
+
+# the other options
+$1 ~ /^[A-Za-z]/ { next }
+
+# the numbers: three per producer (id, articles, queue size), the co-editor queue size last
+{
+    value[numbers++] = $1
+}
+
+END {
+    for (i = 0; i + 3 <= numbers - 1; i += 3) {
+        producers++
+        fit(value[i + 2])
+    }
+    if (numbers > 0) {
+        fit(value[numbers - 1])
+    }
+    capacity = 1
+    while (capacity < largest) {
+        capacity *= 2
+    }
+    printf "// Generated by Static/StaticConfig.awk from %s, do not edit.\n", FILENAME
+    printf "#define STATIC_PIPELINE 1\n"
+    printf "#define STATIC_CONF \"%s\"\n", FILENAME
+    printf "#define STATIC_NUM_PRODUCERS %d\n", producers
+    printf "#define STATIC_QUEUE_CAPACITY %d\n", capacity
+    printf "#define STATIC_ROUTES { %s }\n", routes
+}
@@ -0,0 +1,195 @@
+#include "Stress.h"
+
+/**
+ * The correctness harness of the pipeline. With AUDIT, every produced article gets a number, and the
+ * audit counts how many times each one was displayed or dropped on purpose: at the end, each must
+ * have been exactly one of the two. With JITTER, every stage sleeps a random time between articles,
+ * to shake out interleavings a quiet run never hits. Both are meant for stress runs, and for the
+ * sanitizer builds ("make tsan", "make asan").
+ */
+typedef struct {
+    unsigned char displayed;
+    unsigned char dropped;
+} AuditEntry;
+
+typedef struct {
+    uint64_t produced; // the number of the last produced article
+    sem_t mutex;       // protects the entries
+    AuditEntry* entries; // indexed by article number
+    uint64_t capacity;
+    int shared; // the audit is in memory shared by the stage processes, its entries can't grow
+} Audit;
+
+static Audit localAudit;
+static Audit* audit = &localAudit;
+static pthread_once_t auditOnce = PTHREAD_ONCE_INIT;
+
+static void initAudit() {
+    // a shared audit is set up before the stage processes are forked
+    if (audit->shared) {
+        return;
+    }
+    sem_init(&audit->mutex, 0, 1);
+    audit->capacity = 1024;
+    audit->entries = calloc(audit->capacity, sizeof(AuditEntry));
+}
+
+static size_t sharedAuditSize() {
+    return sizeof(Audit) + SHARED_AUDIT_CAPACITY * sizeof(AuditEntry);
+}
+
+/**
+ * Moves the audit to memory shared with the processes forked from now on (see Processes.h), so the
+ * articles produced in one process and displayed or dropped in another are counted together. The
+ * entries are reserved up front, the pages of the articles never produced are never touched.
+ *
+ * @return 0 on success (or when the audit is disabled), -1 if the memory can't be mapped.
+ */
+int shareAudit() {
+    if (!config.audit || audit->shared) {
+        return 0;
+    }
+    Audit* shared = mmap(NULL, sharedAuditSize(), PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    shared->produced = audit->produced;
+    // pshared = 1: the mutex is used by every process the audit is shared with
+    sem_init(&shared->mutex, 1, 1);
+    shared->entries = (AuditEntry*)(shared + 1);
+    shared->capacity = SHARED_AUDIT_CAPACITY;
+    shared->shared = 1;
+    audit = shared;
+    return 0;
+}
+
+/**
+ * Returns the entry of an article, growing the entries when needed. Called while holding the mutex.
+ * Returns NULL for an article past the entries of a shared audit.
+ */
+static AuditEntry* auditEntry(uint64_t number) {
+    if (number >= audit->capacity && audit->shared) {
+        return NULL;
+    }
+    if (number >= audit->capacity) {
+        uint64_t capacity = audit->capacity;
+        while (number >= capacity) {
+            capacity *= 2;
+        }
+        audit->entries = realloc(audit->entries, capacity * sizeof(AuditEntry));
+        memset(audit->entries + audit->capacity, 0, (capacity - audit->capacity) * sizeof(AuditEntry));
+        audit->capacity = capacity;
+    }
+    return &audit->entries[number];
+}
+
+/**
+ * Numbers an article entering the system (for the audit, and for the stage recording, see Replay.h).
+ *
+ * @param article The produced article.
+ */
+void auditProduced(Article* article) {
+    if (config.audit || config.recordPath != NULL || config.replayPath != NULL) {
+        article->auditId = __atomic_add_fetch(&audit->produced, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Records that an article was dropped on purpose.
+ *
+ * @param article The dropped article.
+ */
+void auditDropped(const Article* article) {
+    if (!config.audit || article->auditId == 0) {
+        return;
+    }
+    pthread_once(&auditOnce, initAudit);
+    sem_wait(&audit->mutex);
+    AuditEntry* entry = auditEntry(article->auditId);
+    if (entry != NULL) {
+        entry->dropped++;
+    }
+    sem_post(&audit->mutex);
+}
+
+/**
+ * Records that an article was displayed.
+ *
+ * @param article The displayed article.
+ */
+void auditDisplayed(const Article* article) {
+    if (!config.audit || article->auditId == 0) {
+        return;
+    }
+    pthread_once(&auditOnce, initAudit);
+    sem_wait(&audit->mutex);
+    AuditEntry* entry = auditEntry(article->auditId);
+    if (entry != NULL) {
+        entry->displayed++;
+    }
+    sem_post(&audit->mutex);
+}
+
+/**
+ * Checks that every produced article was displayed or dropped exactly once, and reports it.
+ * No thread may produce, drop or display anymore.
+ *
+ * @param out Where to write the report.
+ * @return 0 if the audit passed (or is disabled), -1 otherwise.
+ */
+int auditReport(FILE* out) {
+    if (!config.audit) {
+        return 0;
+    }
+    pthread_once(&auditOnce, initAudit);
+    long displayed = 0, dropped = 0, missing = 0, duplicated = 0;
+    for (uint64_t number = 1; number <= audit->produced; number++) {
+        AuditEntry* entry = auditEntry(number);
+        if (entry == NULL) {
+            fprintf(out, "Audit: only the first %llu articles were checked\n", (unsigned long long)number - 1);
+            break;
+        }
+        displayed += entry->displayed;
+        dropped += entry->dropped;
+        int seen = entry->displayed + entry->dropped;
+        if (seen == 0) {
+            if (missing++ < 10) {
+                fprintf(out, "Audit: article %llu was lost\n", (unsigned long long)number);
+            }
+        } else if (seen > 1) {
+            if (duplicated++ < 10) {
+                fprintf(out, "Audit: article %llu was displayed %d times and dropped %d times\n",
+                        (unsigned long long)number, entry->displayed, entry->dropped);
+            }
+        }
+    }
+    fprintf(out, "Audit: %llu produced, %ld displayed, %ld dropped, %ld lost, %ld duplicated: %s\n",
+            (unsigned long long)audit->produced, displayed, dropped, missing, duplicated,
+            missing == 0 && duplicated == 0 ? "PASSED" : "FAILED");
+    sem_destroy(&audit->mutex);
+    if (audit->shared) {
+        munmap(audit, sharedAuditSize());
+        audit = &localAudit;
+    } else {
+        free(audit->entries);
+        audit->entries = NULL;
+        audit->capacity = 0;
+    }
+    return missing == 0 && duplicated == 0 ? 0 : -1;
+}
+
+/**
+ * Sleeps a random time of up to the configured jitter, to vary the interleaving of the stages.
+ */
+void jitter() {
+    static __thread unsigned int seed = 0;
+    if (config.jitterUs <= 0) {
+        return;
+    }
+    if (seed == 0) {
+        seed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)&seed;
+    }
+    usleep(rand_r(&seed) % (config.jitterUs + 1));
+}
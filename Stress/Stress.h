@@ -0,0 +1,32 @@
+#ifndef STRESS_H
+#define STRESS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+
+#include "../Config/Config.h"
+#include "../Article/Article.h"
+
+// the articles a shared audit (see shareAudit) has entries for
+#define SHARED_AUDIT_CAPACITY (1 << 24)
+
+int shareAudit();
+
+void auditProduced(Article* article);
+
+void auditDropped(const Article* article);
+
+void auditDisplayed(const Article* article);
+
+int auditReport(FILE* out);
+
+void jitter();
+
+#endif
@@ -0,0 +1,96 @@
+#!/bin/sh
+# The stress suite ("make stress"): runs randomized configurations of the pipeline under the
+# ThreadSanitizer and the AddressSanitizer + UndefinedBehaviorSanitizer builds, with AUDIT and JITTER.
+# Every configuration draws its producer count, its queue sizes, its stage delays and a set of
+# options (wait strategy, admission policies, bundling, spilling, subscriptions, edit concurrency or
+# autoscaling, stage processes). A run fails on a sanitizer report, on an audit mismatch (exit status
+# 1), on a stage process ending abnormally, or when it doesn't end within STRESS_TIMEOUT seconds (a
+# deadlock); the failing configuration is printed.
+#
+# Usage: sh Stress/stress.sh [runs] [seed]
+
+RUNS=${1:-8}
+SEED=${2:-$(date +%s)}
+TIMEOUT=${STRESS_TIMEOUT:-120}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/stress.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+export TSAN_OPTIONS="halt_on_error=1 exitcode=66"
+export ASAN_OPTIONS="halt_on_error=1 detect_leaks=0"
+export UBSAN_OPTIONS="halt_on_error=1 print_stacktrace=1"
+
+# writes a random configuration, drawn from a seed, to stdout
+generate() {
+    awk -v seed="$1" -v spill="$2" 'BEGIN {
+        srand(seed)
+        categories[0] = "SPORTS"; categories[1] = "NEWS"; categories[2] = "WEATHER"
+        policies[0] = "block"; policies[1] = "drop-oldest"; policies[2] = "drop-newest"; policies[3] = "sample"
+        strategies[0] = "block"; strategies[1] = "spin"; strategies[2] = "adaptive"
+        producers = 1 + int(rand() * 5)
+        for (i = 1; i <= producers; i++) {
+            printf "%d\n%d\n%d\n\n", i, 3 + int(rand() * 30), 1 + int(rand() * 8)
+        }
+        printf "%d\n", 1 + int(rand() * 8)
+        printf "AUDIT\nJITTER %d\n", int(rand() * 500)
+        printf "WAIT_STRATEGY %s\n", strategies[int(rand() * 3)]
+        if (rand() < 0.5) printf "BREAKING_EVERY %d\n", 1 + int(rand() * 4)
+        for (c = 0; c < 3; c++) {
+            if (rand() < 0.3) {
+                printf "POLICY %s %s %d 0.5\n", categories[c], policies[int(rand() * 4)], 1 + int(rand() * 10)
+            }
+        }
+        if (rand() < 0.4) printf "BUNDLE %d %d\n", 1 + int(rand() * 6), int(rand() * 50)
+        if (rand() < 0.4) printf "SPILL %s %d\n", spill, 1 + int(rand() * 10)
+        if (rand() < 0.3) printf "SUBSCRIBE %s %d\n", categories[int(rand() * 3)], int(rand() * 10)
+        if (rand() < 0.3) printf "PROCESSES\n"
+        # the co-editors edit for 0.1 s an article, keep the runs short
+        if (rand() < 0.5) {
+            printf "AUTOSCALE 1 %d 100\n", 1 + int(rand() * 4)
+        } else {
+            printf "EDIT_CONCURRENCY %d\n", 4 + int(rand() * 12)
+        }
+    }'
+}
+
+# runs a configuration under a sanitizer build, 0 if it passed
+check() {
+    binary=$1
+    conf=$2
+    log=$3
+    timeout "$TIMEOUT" "$binary" "$conf" > /dev/null 2> "$log"
+    status=$?
+    if [ $status -eq 124 ]; then
+        echo "$binary: no end after ${TIMEOUT}s"
+        return 1
+    fi
+    if [ $status -ne 0 ] || grep -q "WARNING: ThreadSanitizer\|ERROR: AddressSanitizer\|runtime error\|ended abnormally" "$log"; then
+        echo "$binary: exit status $status"
+        grep "Audit\|WARNING: ThreadSanitizer\|ERROR: AddressSanitizer\|runtime error\|ended abnormally" "$log"
+        return 1
+    fi
+    return 0
+}
+
+echo "Stress: $RUNS runs, seed $SEED"
+failed=0
+run=1
+while [ $run -le "$RUNS" ]; do
+    conf="$WORK/conf$run.txt"
+    mkdir -p "$WORK/spill$run"
+    generate $((SEED + run)) "$WORK/spill$run" > "$conf"
+    for binary in ./a.out.tsan ./a.out.asan; do
+        if ! check "$binary" "$conf" "$WORK/log$run"; then
+            echo "Stress: run $run failed with the configuration:"
+            cat "$conf"
+            failed=$((failed + 1))
+            break
+        fi
+    done
+    run=$((run + 1))
+done
+
+if [ $failed -gt 0 ]; then
+    echo "Stress: $failed of $RUNS runs FAILED (seed $SEED)"
+    exit 1
+fi
+echo "Stress: $RUNS runs PASSED (seed $SEED)"
@@ -0,0 +1,126 @@
+#include "Trace.h"
+
+#ifdef TRACE
+
+typedef struct {
+    const char* name;
+    long startNs;
+    long durationNs;
+} TraceEvent;
+
+// the spans of one thread, written only by that thread
+typedef struct TraceRing {
+    int tid;
+    char threadName[32];
+    long recorded; // spans recorded so far, the ring keeps the last TRACE_RING_SIZE
+    TraceEvent events[TRACE_RING_SIZE];
+    struct TraceRing* next;
+} TraceRing;
+
+static __thread TraceRing* threadRing = NULL;
+static TraceRing* rings = NULL; // every ring, for the shutdown
+static sem_t ringsMutex;
+static int nextTid = 1;
+static pthread_once_t traceOnce = PTHREAD_ONCE_INIT;
+
+static void initTrace() {
+    sem_init(&ringsMutex, 0, 1);
+}
+
+/**
+ * Returns the ring of the calling thread, creating it on its first span.
+ */
+static TraceRing* ownRing() {
+    if (threadRing == NULL) {
+        pthread_once(&traceOnce, initTrace);
+        threadRing = malloc(sizeof(TraceRing));
+        threadRing->recorded = 0;
+        sem_wait(&ringsMutex);
+        threadRing->tid = nextTid++;
+        snprintf(threadRing->threadName, sizeof(threadRing->threadName), "thread %d", threadRing->tid);
+        threadRing->next = rings;
+        rings = threadRing;
+        sem_post(&ringsMutex);
+    }
+    return threadRing;
+}
+
+/**
+ * Returns the time spans are measured with, in nanoseconds.
+ */
+long traceNow() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/**
+ * Records a span of the calling thread, from its start until now.
+ *
+ * @param name    The name of the span, a string that lives as long as the program.
+ * @param startNs When the span started (see traceNow).
+ */
+void traceSpan(const char* name, long startNs) {
+    TraceRing* ring = ownRing();
+    TraceEvent* event = &ring->events[ring->recorded % TRACE_RING_SIZE];
+    event->name = name;
+    event->startNs = startNs;
+    event->durationNs = traceNow() - startNs;
+    ring->recorded++;
+}
+
+/**
+ * Names the calling thread in the trace.
+ *
+ * @param format A printf format with one int.
+ * @param index  The int.
+ */
+void traceThread(const char* format, int index) {
+    TraceRing* ring = ownRing();
+    snprintf(ring->threadName, sizeof(ring->threadName), format, index);
+}
+
+/**
+ * Writes the spans of every thread to the trace file (TRACE_FILE, "trace.json" by default), and
+ * frees the rings. No thread may record spans anymore.
+ */
+void traceWrite() {
+    const char* path = config.tracePath != NULL ? config.tracePath : "trace.json";
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Error opening trace file %s.\n", path);
+        return;
+    }
+    long origin = -1;
+    for (TraceRing* ring = rings; ring != NULL; ring = ring->next) {
+        long first = ring->recorded > TRACE_RING_SIZE ? ring->recorded - TRACE_RING_SIZE : 0;
+        if (ring->recorded > 0 && (origin < 0 || ring->events[first % TRACE_RING_SIZE].startNs < origin)) {
+            origin = ring->events[first % TRACE_RING_SIZE].startNs;
+        }
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    int comma = 0;
+    long total = 0;
+    for (TraceRing* ring = rings; ring != NULL;) {
+        fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                comma ? ",\n" : "", ring->tid, ring->threadName);
+        comma = 1;
+        long first = ring->recorded > TRACE_RING_SIZE ? ring->recorded - TRACE_RING_SIZE : 0;
+        for (long i = first; i < ring->recorded; i++) {
+            TraceEvent* event = &ring->events[i % TRACE_RING_SIZE];
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    event->name, ring->tid, (event->startNs - origin) / 1e3, event->durationNs / 1e3);
+        }
+        total += ring->recorded - first;
+        TraceRing* next = ring->next;
+        free(ring);
+        ring = next;
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    rings = NULL;
+    fprintf(stderr, "Trace: %ld spans written to %s\n", total, path);
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/**
+ * Compile-time tracing of the hot paths, enabled by building with -DTRACE ("make trace").
+ * Every thread records spans (a name, a start and a duration) in its own ring buffer, without any
+ * locking; the rings are written to a Chrome trace / Perfetto JSON file at shutdown. A ring keeps the
+ * last TRACE_RING_SIZE spans of its thread.
+ *
+ * Without -DTRACE the macros expand to nothing.
+ *
+ *   TRACE_BEGIN(wait);                    // starts a span named by a local variable
+ *   waitFor(...);
+ *   TRACE_END(wait, "insertBounded:wait"); // records it under a static name
+ */
+#ifdef TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "../Config/Config.h"
+
+#define TRACE_RING_SIZE (1 << 16)
+
+long traceNow();
+
+void traceSpan(const char* name, long startNs);
+
+void traceThread(const char* format, int index);
+
+void traceWrite();
+
+#define TRACE_BEGIN(span) long span##TraceStart = traceNow()
+#define TRACE_END(span, name) traceSpan(name, span##TraceStart)
+#define TRACE_THREAD(format, index) traceThread(format, index)
+#define TRACE_WRITE() traceWrite()
+
+#else
+
+#define TRACE_BEGIN(span)
+#define TRACE_END(span, name)
+#define TRACE_THREAD(format, index)
+#define TRACE_WRITE()
+
+#endif
+
+#endif
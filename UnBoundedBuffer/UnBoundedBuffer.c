@@ -7,66 +7,464 @@
  */
 void initUnboundedBuffer(UnboundedBuffer* buffer) {
     // Initialize the buffer's variables
-    buffer->messages = malloc(sizeof(char*)*50);
-    buffer->limitSize = 50;
+    for (int i = 0; i < NUM_PRIORITIES; i++) {
+        Lane* lane = &buffer->lanes[i];
+        ArticleRingInit(&lane->ring, 50);
+        initSpill(&lane->spill);
+    }
     buffer->count = 0;
-    buffer->in = 0;
-    buffer->out = 0;
+    buffer->served = 0;
+    buffer->admission = ADMIT_ALL;
+    buffer->limit = 0;
+    buffer->probability = 1;
+    buffer->seed = 1;
+    buffer->dropped = 0;
+    buffer->account = NULL;
+    buffer->shared = NULL;
 
     // Initialize the mutex semaphore to ensure thread safety
     sem_init(&buffer->mutex, 0, 1);
     // Initialize the full semaphore to 0 since the buffer is initially empty
     sem_init(&buffer->full, 0, 0);
+    initWaitState(&buffer->fullWait);
+    sem_init(&buffer->space, 0, 0);
+    initWaitState(&buffer->spaceWait);
+    buffer->notifyFd = -1;
+}
+
+/**
+ * Initializes an unbounded buffer that is a view of a ring in shared memory: inserting copies the
+ * articles into the ring (and frees them), waiting while it is full. The admission policy, the
+ * spilling and the accounting belong to the queue on the other side of the ring, the view is only
+ * inserted into.
+ *
+ * @param buffer Pointer to the UnboundedBuffer struct to be initialized.
+ * @param ring   The ring, owned by the caller.
+ */
+void initSharedUnboundedBuffer(UnboundedBuffer* buffer, ShmRing* ring) {
+    initUnboundedBuffer(buffer);
+    buffer->shared = ring;
 }
 
 /**
- * Inserts a message into the unbounded buffer.
+ * Makes the buffer signal every insertion on an eventfd (notifyFd), so that an event loop can wait for
+ * articles along with its other events. Must be called before the buffer is used.
  *
  * @param buffer Pointer to the UnboundedBuffer struct.
- * @param message The message to be inserted.
+ * @return 0 on success, -1 if the eventfd can't be created.
  */
-void insertUnBounded(UnboundedBuffer* buffer, const char* message) {
-    // Wait until there is available space in the buffer
-    sem_wait(&buffer->mutex);
+int enableNotify(UnboundedBuffer* buffer) {
+    buffer->notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return buffer->notifyFd >= 0 ? 0 : -1;
+}
+
+/**
+ * Limits an unbounded buffer with an admission policy. Must be called before the buffer is used,
+ * the articles it already holds (restored from a checkpoint) count toward the limit.
+ *
+ * @param buffer Pointer to the UnboundedBuffer struct.
+ * @param policy The policy.
+ * @param seed   The seed of the ADMIT_SAMPLE draws.
+ */
+void setAdmissionPolicy(UnboundedBuffer* buffer, const AdmissionPolicy* policy, unsigned int seed) {
+    buffer->admission = policy->type;
+    buffer->limit = policy->limit;
+    buffer->probability = policy->probability;
+    buffer->seed = seed;
+    sem_destroy(&buffer->space);
+    int room = policy->limit > buffer->count ? policy->limit - buffer->count : 0;
+    sem_init(&buffer->space, 0, policy->type == ADMIT_BLOCK ? room : 0);
+}
 
-    // If the buffer is full, increase its capacity
-    if (buffer->count == buffer->limitSize) {
-        int newLimitSize = buffer->limitSize * 2;
-        char** newMessages = realloc(buffer->messages, sizeof(char*) * newLimitSize);
-        // update the next size that should generate a reallocation
-        buffer->messages = newMessages;
-        buffer->limitSize = newLimitSize;
+/**
+ * Returns the bytes of an unbounded buffer (allocated in an array with the others) and the bytes
+ * the allocator reserved for its in-memory rings.
+ */
+static long unboundedFootprint(UnboundedBuffer* buffer) {
+    long bytes = sizeof(UnboundedBuffer);
+    for (int i = 0; i < NUM_PRIORITIES; i++) {
+        bytes += malloc_usable_size(buffer->lanes[i].ring.slots);
     }
+    return bytes;
+}
 
-    // Insert the message into the buffer
-    buffer->messages[buffer->in] = strdup(message);
-    buffer->in++;
-    buffer->count++;
+/**
+ * Counts an unbounded buffer, and the articles in its rings, in a memory account. The spilled
+ * articles aren't in memory, and aren't counted. Must be called before the buffer is shared with
+ * another thread.
+ *
+ * @param buffer  Pointer to the UnboundedBuffer struct.
+ * @param account The account, NULL when memory accounting is disabled.
+ */
+void accountUnboundedBuffer(UnboundedBuffer* buffer, MemoryAccount* account) {
+    if (account == NULL) {
+        return;
+    }
+    buffer->account = account;
+    chargeQueue(account, unboundedFootprint(buffer));
+    for (int i = 0; i < NUM_PRIORITIES; i++) {
+        ArticleRing* ring = &buffer->lanes[i].ring;
+        for (int k = 0; k < ring->count; k++) {
+            chargeMemory(account, 1, articleFootprint(*ArticleRingAt(ring, k)));
+        }
+    }
+}
 
-    // Signal that the buffer is not empty
-    sem_post(&buffer->mutex);
-    sem_post(&buffer->full);
+/**
+ * Pages the spilled articles of a lane back in, a batch at a time, once the lane runs low.
+ * Called while holding the mutex, after an article left the lane's ring.
+ * A spill segment that can't be read back ends the program: its articles (maybe the lane's "DONE")
+ * are still counted in the full permits, and the queue would hand out articles it no longer has.
+ */
+static void pageIn(UnboundedBuffer* buffer, Lane* lane) {
+    int lowWatermark = config.spillThreshold / 2 > 1 ? config.spillThreshold / 2 : 1;
+    if (lane->spill.count > 0 && lane->ring.count < lowWatermark) {
+        while (lane->spill.count > 0 && lane->ring.count < config.spillThreshold) {
+            Article* spilled = spillRead(&lane->spill);
+            if (spilled == NULL) {
+                fprintf(stderr, "Spill: can't read back %ld spilled articles, stopping.\n", lane->spill.count);
+                exit(1);
+            }
+            pushLane(buffer, lane, spilled);
+        }
+    }
+}
 
+/**
+ * Removes the oldest article of the least urgent lane that has one in memory, to make room for a
+ * new one. Called while holding the mutex.
+ *
+ * @return The evicted article, or NULL if there is none to evict.
+ */
+static Article* evictOldest(UnboundedBuffer* buffer) {
+    for (int i = NUM_PRIORITIES - 1; i >= 0; i--) {
+        Lane* lane = &buffer->lanes[i];
+        Article** head = ArticleRingPeek(&lane->ring);
+        if (head != NULL && !isDone(*head)) {
+            Article* article;
+            ArticleRingPop(&lane->ring, &article);
+            buffer->count--;
+            if (buffer->account != NULL) {
+                chargeMemory(buffer->account, -1, -(long)articleFootprint(article));
+            }
+            // the lane must not run out of articles in memory while it has spilled ones
+            pageIn(buffer, lane);
+            return article;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Applies the admission policy to an arriving article, and adds it to the lane of its priority if it
+ * gets in. Called while holding the mutex.
+ *
+ * @return The article dropped by the policy (the arriving one, or the one it evicted), NULL if none.
+ */
+static Article* admit(UnboundedBuffer* buffer, Article* article) {
+    // the DONE article always gets in
+    int limited = buffer->admission != ADMIT_ALL && !isDone(article);
+
+    // apply the admission policy of a buffer at its limit
+    Article* dropped = NULL;
+    if (limited && buffer->count >= buffer->limit) {
+        if (buffer->admission == ADMIT_DROP_OLDEST) {
+            dropped = evictOldest(buffer);
+        }
+        if (buffer->admission == ADMIT_DROP_NEWEST
+            || (buffer->admission == ADMIT_DROP_OLDEST && dropped == NULL)
+            || (buffer->admission == ADMIT_SAMPLE
+                && rand_r(&buffer->seed) >= buffer->probability * ((double)RAND_MAX + 1))) {
+            dropped = article;
+        }
+    }
+    if (dropped != NULL) {
+        buffer->dropped++;
+    }
+    if (dropped == article) {
+        return article;
+    }
+
+    // Past the memory threshold (and until the spilled articles are paged back in, to keep the
+    // lane FIFO), the article goes to the lane's spill segment
+    Lane* lane = &buffer->lanes[article->priority];
+    if (config.spillThreshold <= 0
+        || (lane->spill.count == 0 && lane->ring.count < config.spillThreshold)
+        || spillWrite(&lane->spill, article) != 0) {
+        pushLane(buffer, lane, article);
+    }
+    buffer->count++;
+    return dropped;
 }
 
 /**
- * Removes a message from the unbounded buffer.
+ * Inserts an article into the lane of its priority in the unbounded buffer.
+ * The buffer takes ownership of the article.
  *
  * @param buffer Pointer to the UnboundedBuffer struct.
- * @return The removed message.
+ * @param article The article to be inserted.
  */
-char* removeUnBounded(UnboundedBuffer* buffer) {
-    // Wait until there is a message available in the buffer
-    sem_wait(&buffer->full);
+void insertUnBounded(UnboundedBuffer* buffer, Article* article) {
+    insertUnBoundedBatch(buffer, &article, 1);
+}
+
+/**
+ * Admits articles under a single lock, and signals those that got in. With the ADMIT_BLOCK policy,
+ * the caller already holds the room for them.
+ */
+static void admitArticles(UnboundedBuffer* buffer, Article* const articles[], int numArticles) {
+    TRACE_BEGIN(enqueue);
+    // only a shedding policy drops articles
+    Article** dropped = NULL;
+    if (buffer->admission != ADMIT_ALL && buffer->admission != ADMIT_BLOCK) {
+        dropped = malloc(sizeof(Article*) * numArticles);
+    }
+    int numDropped = 0;
     sem_wait(&buffer->mutex);
+    for (int i = 0; i < numArticles; i++) {
+        Article* article = admit(buffer, articles[i]);
+        if (article != NULL) {
+            dropped[numDropped++] = article;
+        }
+    }
+    sem_post(&buffer->mutex);
+
+    for (int i = 0; i < numDropped; i++) {
+        journalDrop(dropped[i]);
+        auditDropped(dropped[i]);
+        freeArticle(dropped[i]);
+    }
+    free(dropped);
+    // every drop (of an arriving article, or of an evicted one whose place was taken) leaves one
+    // article less to signal
+    int added = numArticles - numDropped;
+    for (int i = 0; i < added; i++) {
+        sem_post(&buffer->full);
+    }
+    if (added > 0 && buffer->notifyFd >= 0) {
+        // wake up the event loop of the co-editor
+        uint64_t value = added;
+        write(buffer->notifyFd, &value, sizeof(value));
+    }
+    TRACE_END(enqueue, "insertUnBounded");
+}
+
+/**
+ * Inserts several articles at once, in order, under a single lock, so that a consumer never sees
+ * only part of them. Each one goes through the admission policy. The buffer takes ownership of them.
+ * With the ADMIT_BLOCK policy, the articles go in as room frees up: each time in a single lock, as
+ * many as there is room for (a batch larger than the limit would never find room for all of them).
+ *
+ * @param buffer      Pointer to the UnboundedBuffer struct.
+ * @param articles    The articles to be inserted.
+ * @param numArticles The number of articles.
+ */
+void insertUnBoundedBatch(UnboundedBuffer* buffer, Article* const articles[], int numArticles) {
+    if (buffer->shared != NULL) {
+        for (int i = 0; i < numArticles; i++) {
+            shmRingPush(buffer->shared, articles[i]);
+            freeArticle(articles[i]);
+        }
+        return;
+    }
+    if (buffer->admission != ADMIT_BLOCK) {
+        admitArticles(buffer, articles, numArticles);
+        return;
+    }
+    int start = 0;
+    while (start < numArticles) {
+        // wait for room for the next article, then take the room there already is for the following ones
+        TRACE_BEGIN(wait);
+        if (!isDone(articles[start])) {
+            acquireSlots(&buffer->space, &buffer->spaceWait, 1, -1);
+        }
+        int end = start + 1;
+        while (end < numArticles && (isDone(articles[end]) || sem_trywait(&buffer->space) == 0)) {
+            end++;
+        }
+        TRACE_END(wait, "insertUnBounded:wait");
+        admitArticles(buffer, articles + start, end - start);
+        start = end;
+    }
+}
+
+/**
+ * Appends an article to the in-memory ring of a lane, growing it when needed.
+ * Called while holding the mutex.
+ *
+ * @param buffer  Pointer to the UnboundedBuffer struct the lane belongs to.
+ * @param lane    Pointer to the lane.
+ * @param article The article to append.
+ */
+void pushLane(UnboundedBuffer* buffer, Lane* lane, Article* article) {
+    // If the lane is full, double its capacity
+    if (lane->ring.count == lane->ring.size) {
+        long oldBytes = buffer->account != NULL ? malloc_usable_size(lane->ring.slots) : 0;
+        ArticleRingResize(&lane->ring, lane->ring.size * 2);
+        if (buffer->account != NULL) {
+            chargeQueue(buffer->account, (long)malloc_usable_size(lane->ring.slots) - oldBytes);
+        }
+    }
+    ArticleRingPush(&lane->ring, article);
+    if (buffer->account != NULL) {
+        chargeMemory(buffer->account, 1, articleFootprint(article));
+    }
+}
 
-    // Remove the message from the buffer
-    char* message = buffer->messages[buffer->out];
-    buffer->out++;
+/**
+ * Takes the next article out of the buffer, serving the priority lanes in order (see selectLane).
+ * Called while holding the mutex.
+ */
+static Article* takeArticle(UnboundedBuffer* buffer) {
+    // Remove the article from the lane to serve
+    int laneCount[NUM_PRIORITIES];
+    Article* heads[NUM_PRIORITIES];
+    for (int i = 0; i < NUM_PRIORITIES; i++) {
+        Lane* lane = &buffer->lanes[i];
+        laneCount[i] = lane->ring.count + lane->spill.count;
+        heads[i] = lane->ring.count > 0 ? *ArticleRingPeek(&lane->ring) : NULL;
+    }
+    int index = selectLane(laneCount, heads, &buffer->served);
+    if (index < 0) {
+        // a full permit is held for every article, the lanes can't all be empty
+        fprintf(stderr, "removeUnBounded: the lanes are empty, the queue is corrupted.\n");
+        abort();
+    }
+    Lane* lane = &buffer->lanes[index];
+    Article* article;
+    ArticleRingPop(&lane->ring, &article);
     buffer->count--;
+    if (buffer->account != NULL) {
+        chargeMemory(buffer->account, -1, -(long)articleFootprint(article));
+    }
+
+    pageIn(buffer, lane);
+    return article;
+}
 
+/**
+ * Takes the next articles out of the buffer under a single lock.
+ * The caller already holds one of the full slots for each of them.
+ */
+static void takeArticles(UnboundedBuffer* buffer, Article* articles[], int numArticles) {
+    TRACE_BEGIN(dequeue);
+    sem_wait(&buffer->mutex);
+    for (int i = 0; i < numArticles; i++) {
+        articles[i] = takeArticle(buffer);
+    }
     // releasing the mutex and allowing other threads to access the buffer.
     sem_post(&buffer->mutex);
+    for (int i = 0; i < numArticles; i++) {
+        if (buffer->admission == ADMIT_BLOCK && !isDone(articles[i])) {
+            sem_post(&buffer->space);
+        }
+    }
+    TRACE_END(dequeue, "removeUnBounded");
+}
+
+/**
+ * Removes up to a given number of articles at once, the way every variant below does: waits for the
+ * first one (see acquireSlots), takes the others only if they are already there, and removes them
+ * all under a single lock.
+ *
+ * @param buffer    Pointer to the UnboundedBuffer struct.
+ * @param articles  Set to the removed articles, owned by the caller.
+ * @param max       The most articles to remove.
+ * @param timeoutMs The longest time to wait, in milliseconds: -1 as long as it takes, 0 not at all.
+ * @return The number of removed articles, 0 if the buffer stayed empty.
+ */
+static int removeArticles(UnboundedBuffer* buffer, Article* articles[], int max, long timeoutMs) {
+    TRACE_BEGIN(wait);
+    int numArticles = acquireSlots(&buffer->full, &buffer->fullWait, max, timeoutMs);
+    TRACE_END(wait, "removeUnBounded:wait");
+    if (numArticles > 0) {
+        takeArticles(buffer, articles, numArticles);
+    }
+    return numArticles;
+}
 
-    return message;
-}
\ No newline at end of file
+/**
+ * Removes an article from the unbounded buffer, serving the priority lanes in order (see selectLane).
+ *
+ * @param buffer Pointer to the UnboundedBuffer struct.
+ * @return The removed article, owned by the caller.
+ */
+Article* removeUnBounded(UnboundedBuffer* buffer) {
+    Article* article;
+    removeArticles(buffer, &article, 1, -1);
+    return article;
+}
+
+/**
+ * Removes up to a given number of articles at once, in the order removeUnBounded would. Waits for the
+ * first one, and takes the others only if they are already there.
+ *
+ * @param buffer   Pointer to the UnboundedBuffer struct.
+ * @param articles Set to the removed articles, owned by the caller.
+ * @param max      The most articles to remove.
+ * @return The number of removed articles, at least 1.
+ */
+int removeUnBoundedBatch(UnboundedBuffer* buffer, Article* articles[], int max) {
+    return removeArticles(buffer, articles, max, -1);
+}
+
+/**
+ * Removes an article from the unbounded buffer if there is one, without waiting.
+ *
+ * @param buffer Pointer to the UnboundedBuffer struct.
+ * @return The removed article, owned by the caller, or NULL if the buffer is empty.
+ */
+Article* tryRemoveUnBounded(UnboundedBuffer* buffer) {
+    Article* article;
+    return removeArticles(buffer, &article, 1, 0) > 0 ? article : NULL;
+}
+
+/**
+ * Removes an article from the unbounded buffer, waiting while it is empty, but no longer than a timeout.
+ *
+ * @param buffer    Pointer to the UnboundedBuffer struct.
+ * @param timeoutMs The longest time to wait, in milliseconds.
+ * @return The removed article, owned by the caller, or NULL if the buffer stayed empty.
+ */
+Article* timedRemoveUnBounded(UnboundedBuffer* buffer, long timeoutMs) {
+    Article* article;
+    // a timeout that already passed doesn't wait
+    return removeArticles(buffer, &article, 1, timeoutMs > 0 ? timeoutMs : 0) > 0 ? article : NULL;
+}
+
+/**
+ * Removes up to a given number of articles at once, like removeUnBoundedBatch, waiting for the first
+ * one no longer than a timeout.
+ *
+ * @param buffer    Pointer to the UnboundedBuffer struct.
+ * @param articles  Set to the removed articles, owned by the caller.
+ * @param max       The most articles to remove.
+ * @param timeoutMs The longest time to wait, in milliseconds.
+ * @return The number of removed articles, 0 if the buffer stayed empty.
+ */
+int timedRemoveUnBoundedBatch(UnboundedBuffer* buffer, Article* articles[], int max, long timeoutMs) {
+    return removeArticles(buffer, articles, max, timeoutMs > 0 ? timeoutMs : 0);
+}
+
+/**
+ * Frees the resources of an unbounded buffer, along with the articles still inside it.
+ * No thread may use the buffer anymore.
+ *
+ * @param buffer Pointer to the UnboundedBuffer struct.
+ */
+void destroyUnboundedBuffer(UnboundedBuffer* buffer) {
+    for (int i = 0; i < NUM_PRIORITIES; i++) {
+        Lane* lane = &buffer->lanes[i];
+        for (int j = 0; j < lane->ring.count; j++) {
+            freeArticle(*ArticleRingAt(&lane->ring, j));
+        }
+        ArticleRingDestroy(&lane->ring);
+        destroySpill(&lane->spill);
+    }
+    sem_destroy(&buffer->mutex);
+    sem_destroy(&buffer->full);
+    sem_destroy(&buffer->space);
+    if (buffer->notifyFd >= 0) {
+        close(buffer->notifyFd);
+    }
+}
@@ -4,21 +4,88 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
+#include "../cacheline.h"
+#include "../Article/Article.h"
+#include "../WaitStrategy/WaitStrategy.h"
+#include "../Spill/Spill.h"
+#include "../Journal/Journal.h"
+#include "../Stress/Stress.h"
+#include "../Trace/Trace.h"
+#include "../Memory/Memory.h"
+#include "../ShmRing/ShmRing.h"
+
+// A growable FIFO ring of articles (in memory), one per priority lane, followed by the articles spilled to disk.
 typedef struct {
-    char** messages;
-    int limitSize;
-    int count;
-    int in;
-    int out;
+    ArticleRing ring;
+    Spill spill;
+} Lane;
+
+/**
+ * An unbounded buffer of articles with a lane per priority, served in priority order.
+ * An admission policy (see setAdmissionPolicy) may limit it, blocking or shedding articles.
+ *
+ * The shared state (touched under the mutex) and the co-editor side (full) live on separate cache
+ * lines. Arrays of unbounded buffers must be allocated cache-line aligned.
+ *
+ * A buffer may instead be a view of a ring in shared memory (see initSharedUnboundedBuffer), the
+ * inserting side of a category queue whose co-editors run in another process.
+ */
+typedef struct {
+    ShmRing* shared; // the ring the buffer is a view of, NULL for a buffer of this process
+
+    // shared state, only touched while holding the mutex
     sem_t mutex;
-    sem_t full;
-} UnboundedBuffer;
+    int count;
+    Lane lanes[NUM_PRIORITIES];
+    int served; // articles served in a row ahead of a waiting lower lane
+    AdmissionType admission;
+    int limit;          // articles held before the admission policy applies
+    double probability; // admission probability of ADMIT_SAMPLE
+    unsigned int seed;
+    long dropped;
+    MemoryAccount* account; // the memory account of the category queues, NULL when not accounted
+
+    // dispatcher side, used by ADMIT_BLOCK
+    CACHE_ALIGNED sem_t space;
+    WaitState spaceWait;
+
+    // co-editor side
+    CACHE_ALIGNED sem_t full;
+    WaitState fullWait;
+    int notifyFd; // an eventfd written on every insertion, for an event loop consumer, -1 if none
+} CACHE_ALIGNED UnboundedBuffer;
 
 void initUnboundedBuffer(UnboundedBuffer* buffer);
 
-void insertUnBounded(UnboundedBuffer* buffer, const char* message);
+void initSharedUnboundedBuffer(UnboundedBuffer* buffer, ShmRing* ring);
+
+int enableNotify(UnboundedBuffer* buffer);
+
+void setAdmissionPolicy(UnboundedBuffer* buffer, const AdmissionPolicy* policy, unsigned int seed);
+
+void accountUnboundedBuffer(UnboundedBuffer* buffer, MemoryAccount* account);
+
+void insertUnBounded(UnboundedBuffer* buffer, Article* article);
+
+void insertUnBoundedBatch(UnboundedBuffer* buffer, Article* const articles[], int numArticles);
+
+void pushLane(UnboundedBuffer* buffer, Lane* lane, Article* article);
+
+Article* removeUnBounded(UnboundedBuffer* buffer);
+
+int removeUnBoundedBatch(UnboundedBuffer* buffer, Article* articles[], int max);
+
+Article* tryRemoveUnBounded(UnboundedBuffer* buffer);
+
+Article* timedRemoveUnBounded(UnboundedBuffer* buffer, long timeoutMs);
+
+int timedRemoveUnBoundedBatch(UnboundedBuffer* buffer, Article* articles[], int max, long timeoutMs);
 
-char* removeUnBounded(UnboundedBuffer* buffer);
+void destroyUnboundedBuffer(UnboundedBuffer* buffer);
 
-#endif
\ No newline at end of file
+#endif
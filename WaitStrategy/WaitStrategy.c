@@ -0,0 +1,135 @@
+#include "WaitStrategy.h"
+
+// number of sched_yield rounds between spinning and sleeping on the semaphore
+#define YIELD_ROUNDS 8
+// the adaptive budget never drops below this, so it can grow back when waits get short again
+#define MIN_SPIN_BUDGET 16
+
+/**
+ * Tells the CPU we are in a spin loop (saves power and frees the pipeline for the sibling
+ * hyper-thread).
+ */
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+/**
+ * Moves the spin budget of a wait site towards the length of the last wait
+ * (an exponential moving average with weight 1/8, like glibc's adaptive mutexes).
+ *
+ * @param state    The wait site.
+ * @param observed The number of spins the last wait would have needed.
+ */
+static void adaptBudget(WaitState* state, int observed) {
+    int budget = __atomic_load_n(&state->spinBudget, __ATOMIC_RELAXED);
+    budget += (observed - budget) / 8;
+    if (budget < MIN_SPIN_BUDGET) {
+        budget = MIN_SPIN_BUDGET;
+    }
+    if (budget > config.spinLimit) {
+        budget = config.spinLimit;
+    }
+    __atomic_store_n(&state->spinBudget, budget, __ATOMIC_RELAXED);
+}
+
+/**
+ * Initializes the state of a wait site.
+ *
+ * @param state Pointer to the WaitState to be initialized.
+ */
+void initWaitState(WaitState* state) {
+    // start low, the budget grows as soon as short waits are observed
+    state->spinBudget = MIN_SPIN_BUDGET;
+}
+
+/**
+ * Sets a deadline (on the clock of sem_timedwait) a given time from now.
+ *
+ * @param deadline The deadline to set.
+ * @param ms       Milliseconds from now.
+ */
+void deadlineAfterMs(struct timespec* deadline, long ms) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_nsec += (ms % 1000) * 1000000L;
+    deadline->tv_sec += ms / 1000 + deadline->tv_nsec / 1000000000L;
+    deadline->tv_nsec %= 1000000000L;
+}
+
+/**
+ * Sleeps on a semaphore until it can be decremented, or until the deadline if there is one.
+ */
+static int block(sem_t* sem, const struct timespec* deadline) {
+    if (deadline == NULL) {
+        sem_wait(sem);
+        return 0;
+    }
+    while (sem_timedwait(sem, deadline) != 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Decrements a counting semaphore, waiting according to the configured wait strategy:
+ * spinning with pause instructions, then yielding the CPU, and only then sleeping in sem_wait.
+ *
+ * @param sem   The semaphore to decrement.
+ * @param state The state of the wait site, used by the adaptive strategy.
+ */
+void waitFor(sem_t* sem, WaitState* state) {
+    waitForUntil(sem, state, NULL);
+}
+
+/**
+ * Like waitFor, but gives up at a deadline.
+ *
+ * @param sem      The semaphore to decrement.
+ * @param state    The state of the wait site, used by the adaptive strategy.
+ * @param deadline When to give up (see deadlineAfterMs), NULL to wait as long as it takes.
+ * @return 0 once the semaphore was decremented, -1 if the deadline passed first.
+ */
+int waitForUntil(sem_t* sem, WaitState* state, const struct timespec* deadline) {
+    if (config.waitStrategy == WAIT_BLOCK) {
+        return block(sem, deadline);
+    }
+    if (sem_trywait(sem) == 0) {
+        return 0;
+    }
+
+    // adaptive: spin up to twice the estimated wait, so the estimate can grow (like glibc's adaptive mutexes)
+    int budget = config.spinLimit;
+    if (config.waitStrategy == WAIT_ADAPTIVE) {
+        budget = __atomic_load_n(&state->spinBudget, __ATOMIC_RELAXED);
+        budget = 2 * budget + 10 < config.spinLimit ? 2 * budget + 10 : config.spinLimit;
+    }
+
+    // spin
+    for (int i = 1; i <= budget; i++) {
+        cpuRelax();
+        if (sem_trywait(sem) == 0) {
+            adaptBudget(state, i);
+            return 0;
+        }
+    }
+
+    // yield, the other side is probably not running - keep the estimate as is
+    for (int i = 0; i < YIELD_ROUNDS; i++) {
+        sched_yield();
+        if (sem_trywait(sem) == 0) {
+            return 0;
+        }
+    }
+
+    // block, spinning was a waste of time - let the estimate shrink
+    int result = block(sem, deadline);
+    adaptBudget(state, __atomic_load_n(&state->spinBudget, __ATOMIC_RELAXED) / 2);
+    return result;
+}
@@ -0,0 +1,28 @@
+#ifndef WAITSTRATEGY_H
+#define WAITSTRATEGY_H
+
+#include <semaphore.h>
+#include <sched.h>
+#include <errno.h>
+#include <time.h>
+
+#include "../Config/Config.h"
+
+/**
+ * Per-wait-site state of the adaptive strategy: an estimate (in spin iterations) of how long waits at
+ * this site recently took. Several threads may share a wait site; the budget is only a heuristic, so it is
+ * read and written with relaxed atomics.
+ */
+typedef struct {
+    int spinBudget;
+} WaitState;
+
+void initWaitState(WaitState* state);
+
+void waitFor(sem_t* sem, WaitState* state);
+
+int waitForUntil(sem_t* sem, WaitState* state, const struct timespec* deadline);
+
+void deadlineAfterMs(struct timespec* deadline, long ms);
+
+#endif
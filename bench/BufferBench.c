@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../BoundedBuffer/BoundedBuffer.h"
+#include "../Config/Config.h"
+#include "../Queue/Queue.h"
+
+/**
+ * Measures the throughput of independent producer/consumer pairs, each pair working on its own
+ * BoundedBuffer, with every thread pinned to its own core (round robin over the online cores).
+ *
+ * By default ("adjacent") the buffers sit next to each other in one array, so with the packed layout
+ * the consumer side of a buffer shares a cache line with the producer side of the next one, and the
+ * pairs contend on lines they never share logically. With "separate", each buffer comes from
+ * initBuffer, on its own cache lines, and only the sharing inside a buffer is left.
+ *
+ * Built twice by "make bench": bench/padded uses the cache-line aligned layout and bench/packed is
+ * compiled with -DBUFFER_PACKED. The difference only shows with the threads on several cores.
+ *
+ * The "record" and "batch" modes run the pairs on a typed queue of fixed-size records held by value
+ * (see Queue.h) instead, moving one record or a batch of records at a time, to compare against
+ * passing malloc'd articles by pointer.
+ *
+ * Usage: ./bench/padded [pairs] [items per pair] [queue size] [block|spin|adaptive] [article|record|batch]
+ *                       [adjacent|separate]
+ */
+
+#define BENCH_BATCH 16
+
+typedef struct {
+    int producer;
+    int seq;
+    char text[24];
+} Record;
+
+DEFINE_QUEUE(RecordQueue, Record)
+
+typedef struct {
+    BoundedBuffer* buffer;
+    RecordQueue* queue;
+    int items;
+} Pair;
+
+void* benchProduce(void* arg) {
+    Pair* pair = (Pair*)arg;
+    for (int i = 0; i < pair->items; i++) {
+        insertBounded(pair->buffer, newArticle("Producer 0 SPORTS 0", PRIORITY_NORMAL));
+    }
+    return NULL;
+}
+
+void* benchConsume(void* arg) {
+    Pair* pair = (Pair*)arg;
+    for (int i = 0; i < pair->items; i++) {
+        freeArticle(removeBounded(pair->buffer));
+    }
+    return NULL;
+}
+
+void* benchProduceRecords(void* arg) {
+    Pair* pair = (Pair*)arg;
+    Record record = {.producer = 0, .text = "Producer 0 SPORTS 0"};
+    for (int i = 0; i < pair->items; i++) {
+        record.seq = i;
+        RecordQueuePush(pair->queue, record);
+    }
+    return NULL;
+}
+
+void* benchConsumeRecords(void* arg) {
+    Pair* pair = (Pair*)arg;
+    Record record;
+    for (int i = 0; i < pair->items; i++) {
+        RecordQueuePop(pair->queue, &record);
+    }
+    return NULL;
+}
+
+void* benchProduceBatches(void* arg) {
+    Pair* pair = (Pair*)arg;
+    Record records[BENCH_BATCH] = {0};
+    for (int i = 0; i < pair->items; i += BENCH_BATCH) {
+        int n = pair->items - i < BENCH_BATCH ? pair->items - i : BENCH_BATCH;
+        for (int j = 0; j < n; j++) {
+            records[j].seq = i + j;
+        }
+        RecordQueuePushBatch(pair->queue, records, n);
+    }
+    return NULL;
+}
+
+void* benchConsumeBatches(void* arg) {
+    Pair* pair = (Pair*)arg;
+    Record records[BENCH_BATCH];
+    for (int i = 0; i < pair->items;) {
+        int max = pair->items - i < BENCH_BATCH ? pair->items - i : BENCH_BATCH;
+        i += RecordQueuePopBatch(pair->queue, records, max);
+    }
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+    int numPairs = argc > 1 ? atoi(argv[1]) : 4;
+    int items = argc > 2 ? atoi(argv[2]) : 1000000;
+    int queueSize = argc > 3 ? atoi(argv[3]) : 64;
+    initConfig();
+    if (argc > 4) {
+        char option[64];
+        snprintf(option, sizeof(option), "WAIT_STRATEGY %s", argv[4]);
+        parseOption(option);
+    }
+    const char* mode = argc > 5 ? argv[5] : "article";
+    void* (*produce)(void*) = benchProduce;
+    void* (*consume)(void*) = benchConsume;
+    if (strcmp(mode, "record") == 0) {
+        produce = benchProduceRecords;
+        consume = benchConsumeRecords;
+    } else if (strcmp(mode, "batch") == 0) {
+        produce = benchProduceBatches;
+        consume = benchConsumeBatches;
+    } else {
+        mode = "article";
+    }
+    int typed = produce != benchProduce;
+    int adjacent = argc <= 6 || strcmp(argv[6], "separate") != 0;
+
+    // the adjacent queues are laid out back to back, like the entries of any array of them
+    BoundedBuffer* buffers = NULL;
+    RecordQueue* queues = NULL;
+    if (adjacent && typed) {
+        posix_memalign((void**)&queues, CACHE_LINE_SIZE, sizeof(RecordQueue) * numPairs);
+    } else if (adjacent) {
+        posix_memalign((void**)&buffers, CACHE_LINE_SIZE, sizeof(BoundedBuffer) * numPairs);
+    }
+    Pair* pairs = malloc(sizeof(Pair) * numPairs);
+    pthread_t* threads = malloc(sizeof(pthread_t) * numPairs * 2);
+    for (int i = 0; i < numPairs; i++) {
+        pairs[i].buffer = NULL;
+        pairs[i].queue = NULL;
+        if (typed) {
+            if (adjacent) {
+                pairs[i].queue = &queues[i];
+            } else {
+                posix_memalign((void**)&pairs[i].queue, CACHE_LINE_SIZE, sizeof(RecordQueue));
+            }
+            RecordQueueInit(pairs[i].queue, queueSize);
+        } else if (adjacent) {
+            pairs[i].buffer = &buffers[i];
+            initBufferAt(pairs[i].buffer, queueSize);
+        } else {
+            pairs[i].buffer = initBuffer(queueSize);
+        }
+        pairs[i].items = items;
+    }
+
+    // every thread on its own core, so the neighbouring pairs really run at the same time
+    long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < numPairs; i++) {
+        pthread_create(&threads[2 * i], NULL, produce, &pairs[i]);
+        pthread_create(&threads[2 * i + 1], NULL, consume, &pairs[i]);
+        for (int k = 2 * i; k <= 2 * i + 1; k++) {
+            cpu_set_t cores;
+            CPU_ZERO(&cores);
+            CPU_SET(k % numCores, &cores);
+            pthread_setaffinity_np(threads[k], sizeof(cores), &cores);
+        }
+    }
+    for (int i = 0; i < numPairs * 2; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+#ifdef BUFFER_PACKED
+    const char* layout = "packed";
+#else
+    const char* layout = "padded";
+#endif
+    const char* strategies[] = {"block", "spin", "adaptive"};
+    printf("%s/%s/%s/%s: sizeof(BoundedBuffer)=%zu pairs=%d items=%d queue=%d cores=%ld time=%.3fs "
+           "throughput=%.0f items/s\n", layout, strategies[config.waitStrategy], mode,
+           adjacent ? "adjacent" : "separate", sizeof(BoundedBuffer), numPairs, items, queueSize, numCores, seconds,
+           (double)numPairs * items / seconds);
+
+    for (int i = 0; i < numPairs; i++) {
+        if (typed) {
+            RecordQueueDestroy(pairs[i].queue);
+            if (!adjacent) {
+                free(pairs[i].queue);
+            }
+        } else if (adjacent) {
+            destroyBufferAt(pairs[i].buffer);
+        } else {
+            destroyBuffer(pairs[i].buffer);
+        }
+    }
+    free(buffers);
+    free(queues);
+    free(threads);
+    free(pairs);
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef CACHELINE_H
+#define CACHELINE_H
+
+// Size of a cache line on the targets we run on (x86-64 and most ARM64 cores).
+#define CACHE_LINE_SIZE 64
+
+// Starts a new cache line inside a struct, so that fields written by different threads
+// don't share a line. Building with -DBUFFER_PACKED restores the packed layout (used by the
+// buffer benchmark to measure the difference).
+#ifdef BUFFER_PACKED
+#define CACHE_ALIGNED
+#else
+#define CACHE_ALIGNED __attribute__((aligned(CACHE_LINE_SIZE)))
+#endif
+
+#endif
@@ -1,11 +1,18 @@
+#ifndef GLOBALS_H
+#define GLOBALS_H
+
+#include "./Producer/Producer.h"
+#include "./BoundedBuffer/BoundedBuffer.h"
+
 #define MAX_MESSAGE_LENGTH 100
 #define NUM_MESSAGE_TYPES 3
 #define NUM_CO_EDITORS 3
 
 //----------------GLOBALS------------------
-int numProducers;
-int coEditorBufferSize;
-Producer** producers;
-BoundedBuffer* sharedBuffer;
-char** messages;
+extern int numProducers;
+extern int coEditorBufferSize;
+extern Producer** producers;
+extern BoundedBuffer* sharedBuffer;
+extern char** messages;
 
+#endif
@@ -12,13 +12,23 @@
 #include "./Dispatcher/Dispatcher.h"
 #include "./CoEditor/CoEditor.h"
 #include "./ScreenManager/ScreenManager.h"
+#include "./Processes/Processes.h"
 #include "./globals.h"
 
+//----------------GLOBALS------------------
+int numProducers;
+int coEditorBufferSize;
+Producer** producers;
+BoundedBuffer* sharedBuffer;
+char** messages;
+
 void freeProducers();
 void freeDispatcher(Dispatcher* dispatcher);
 void freeSharedBuffer(BoundedBuffer* buffer);
 void cleanUp(Dispatcher* dispatcher, BoundedBuffer* sharedBuffer);
-void programLogic();
+int programLogic();
+void startJournal();
+void startReplay();
 
 
 void freeProducers() {
@@ -32,21 +42,13 @@ void freeProducers() {
 
     // Free the memory for each producer
     for (int i = 0; i < numProducers; i++) {
-        // Free the buffer data
-        for (int j = 0; j < producers[i]->buffer->size; j++) {
-            free(producers[i]->buffer->data[j]);
-        }
-        free(producers[i]->buffer->data);
-
-        // Destroy the semaphores
-        sem_destroy(&producers[i]->buffer->mutex);
-        sem_destroy(&producers[i]->buffer->empty);
-        sem_destroy(&producers[i]->buffer->full);
-
-        // Free the buffer itself
-        free(producers[i]->buffer);
+        // Free the buffer, with the articles left in it
+        destroyBuffer(producers[i]->buffer);
 
         // Free the producer
+        free(producers[i]->path);
+        free(producers[i]->replay);
+        free(producers[i]->replayNs);
         free(producers[i]);
     }
 
@@ -56,23 +58,29 @@ void freeProducers() {
 
 void freeDispatcher(Dispatcher* dispatcher) {
     // Free the unbounded queues of the sorted articles
-    for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
-        UnboundedBuffer* buffer = &dispatcher->dispatcherQueues[i];
-        free(buffer->messages);
-        sem_destroy(&buffer->mutex);
-        sem_destroy(&buffer->full);
-    }
+    destroyCategoryQueues(dispatcher->dispatcherQueues);
 
     // Free the dispatcher queues array
     free(dispatcher->dispatcherQueues);
+    free(dispatcher->producers);
+    free(dispatcher->buffers);
+    free(dispatcher->routes);
+    destroySelector(&dispatcher->selector);
+    if (dispatcher->bundles != NULL) {
+        for (int i = 0; i < NUM_MESSAGE_TYPES; i++) {
+            free(dispatcher->bundles[i].articles);
+        }
+        free(dispatcher->bundles);
+    }
+    free(dispatcher->indices);
+    free(dispatcher->nextSeq);
+    if (dispatcher->dedup != NULL) {
+        destroyDedupSet(dispatcher->dedup);
+    }
 }
 
 void freeSharedBuffer(BoundedBuffer* buffer) {
-    free(buffer->data);
-    sem_destroy(&buffer->mutex);
-    sem_destroy(&buffer->empty);
-    sem_destroy(&buffer->full);
-    free(buffer);
+    destroyBuffer(buffer);
 }
 
 void cleanUp(Dispatcher* dispatcher, BoundedBuffer* sharedBuffer) {
@@ -82,6 +90,85 @@ void cleanUp(Dispatcher* dispatcher, BoundedBuffer* sharedBuffer) {
 }
 
 
+/**
+ * Opens the journal when journaling is enabled. In the recovery mode, the articles the previous run
+ * accepted but never published are replayed first, by an extra producer.
+ */
+void startJournal() {
+    if (config.journalPath == NULL) {
+        return;
+    }
+    if (config.recover) {
+        Article** pending;
+        int numPending = recoverJournal(config.journalPath, &pending);
+        if (numPending < 0) {
+            fprintf(stderr, "Error reading journal %s.\n", config.journalPath);
+        } else if (numPending > 0) {
+            Producer* producer = malloc(sizeof(Producer));
+            createReplayProducer(producer, numProducers, pending, NULL, numPending);
+            addProducer(producer);
+        } else {
+            free(pending);
+        }
+        fprintf(stderr, "Journal: recovered %d unpublished articles\n", numPending > 0 ? numPending : 0);
+    }
+    openJournal(config.journalPath, config.journalCommitMs);
+}
+
+/**
+ * With REPLAY, replaces the configured producers with the producers of the recording, each sending
+ * its recorded articles on their recorded schedule.
+ */
+void startReplay() {
+    if (config.replayPath == NULL) {
+        return;
+    }
+    Arrival* arrivals;
+    int numArrivals = loadRecording(config.replayPath, &arrivals);
+    if (numArrivals < 0) {
+        return;
+    }
+    for (int i = 0; i < numProducers; i++) {
+        destroyBuffer(producers[i]->buffer);
+        free(producers[i]->path);
+        free(producers[i]);
+    }
+    numProducers = 0;
+
+    // the arrivals are in time order, split them by producer
+    int maxProducer = -1;
+    for (int i = 0; i < numArrivals; i++) {
+        if (arrivals[i].producer > maxProducer) {
+            maxProducer = arrivals[i].producer;
+        }
+    }
+    for (int p = 0; p <= maxProducer; p++) {
+        int count = 0;
+        for (int i = 0; i < numArrivals; i++) {
+            count += arrivals[i].producer == p;
+        }
+        if (count == 0) {
+            continue;
+        }
+        Article** articles = malloc(sizeof(Article*) * count);
+        long* arrivalsNs = malloc(sizeof(long) * count);
+        for (int i = 0, k = 0; i < numArrivals; i++) {
+            if (arrivals[i].producer == p) {
+                articles[k] = newArticle(arrivals[i].text, arrivals[i].priority);
+                arrivalsNs[k++] = arrivals[i].offsetNs;
+            }
+        }
+        Producer* producer = malloc(sizeof(Producer));
+        createReplayProducer(producer, p, articles, arrivalsNs, count);
+        addProducer(producer);
+    }
+    for (int i = 0; i < numArrivals; i++) {
+        free(arrivals[i].text);
+    }
+    free(arrivals);
+    fprintf(stderr, "Replay: %d articles of %d producers from %s\n", numArrivals, numProducers, config.replayPath);
+}
+
 /**
  * Implements the logic of the program:
  * - Create and run the producers for to generate messages.
@@ -90,38 +177,100 @@ void cleanUp(Dispatcher* dispatcher, BoundedBuffer* sharedBuffer) {
  * - Creates and runs the Co-Editors to remove the messages from the sorted unbounded queues, and
  *   insert them into the last shared bounded buffer, which they would be extract from by the screen
  *   manager and would be printed to the screen.
+ *
+ * @return 0, or -1 if the exactly-once audit failed.
  */
-void programLogic() {
-     pthread_t* producerThreads = runProducers();
+int programLogic() {
+    // in the multi-process mode the producers, the co-editors and the screen manager are forked
+    // before any thread starts, and the queues between the stages move to shared memory
+    if (config.processes && startStageProcesses() != 0) {
+        config.processes = 0;
+    }
+    if (!config.processes) {
+        runProducers();
+        sharedBuffer = initBuffer(coEditorBufferSize);
+        accountBuffer(sharedBuffer, memoryAccount(MEMORY_SHARED));
+    }
+    // the control channel may add producers and resize the queues from now on
+    if (config.controlPath != NULL) {
+        startControl(config.controlPath);
+    }
 
     // Create the dispatcher and initialize it with the producer queues
     Dispatcher dispatcher;
-    dispatcher.dispatcherQueues =(UnboundedBuffer *) malloc(sizeof(UnboundedBuffer)*3);
+    // the queues are written by different threads, keep each one on its own cache lines
+    if (posix_memalign((void**)&dispatcher.dispatcherQueues, CACHE_LINE_SIZE,
+                       sizeof(UnboundedBuffer) * NUM_MESSAGE_TYPES) != 0) {
+        fprintf(stderr, "Error allocating the dispatcher queues.\n");
+        exit(1);
+    }
     initDispatcher(&dispatcher);
+    // dump the memory of the stages while they run
+    startMemoryReport();
     // Run the dispatcher logic
 
     pthread_t dispatcherThread;
     pthread_create(&dispatcherThread, NULL, dispatche, (void*)&dispatcher);
+
+    // run the co-editors alongside the dispatcher, until the screen manager displayed everything
+    // (in the multi-process mode, they run in a process of their own)
+    if (config.processes) {
+        waitEditingProcesses();
+    } else {
+        runCoEditors(&dispatcher);
+    }
+    printf("DONE\n");
     pthread_join(dispatcherThread, NULL);
-    
-    // create the last bounded shared buffer
-    sharedBuffer = initBuffer(coEditorBufferSize);
-    pthread_t* coEditorThreads = runCoEditors(&dispatcher);
-    
+    // the dispatcher only ends once the control channel is closed, so no producer comes anymore
+    stopControl();
+    joinProducers();
+    // save the progress of a run stopped by a signal
+    finishCheckpoint();
+
+    // commit the last journal records
+    closeJournal();
+    if (config.processes) {
+        stopStageProcesses();
+    }
+
+    // every thread is done, write the spans of a tracing build and the recording
+    TRACE_WRITE();
+    if (finishRecording(stderr) != 0) {
+        fprintf(stderr, "Error writing recording %s.\n", config.recordPath);
+    }
+
+    stopMemoryReport(stderr);
+
     // free all allocated memory
     cleanUp(&dispatcher, sharedBuffer);
+    return auditReport(stderr);
 }
 
 int main(int argc, char* argv[]) {
+    // "--decompress <file>" prints a file written with COMPRESSED_OUTPUT
+    if (argc == 3 && strcmp(argv[1], "--decompress") == 0) {
+        return decompressFile(argv[2], stdout) == 0 ? 0 : 1;
+    }
     if (argc != 2) {
         return 1;
     }
 
     const char* configFile = argv[1];
 
+    initConfig();
     readConfigurationFile(configFile);
+#ifdef STATIC_PIPELINE
+    if (numProducers != STATIC_NUM_PRODUCERS) {
+        fprintf(stderr, "This static build was generated for %d producers (from %s), not %d.\n", STATIC_NUM_PRODUCERS,
+                STATIC_CONF, numProducers);
+    }
+#endif
+    startReplay();
+    // before the journal's thread, so that every thread blocks the signals of the checkpoint
+    startCheckpoint();
+    startJournal();
+    startRecording();
 
-    programLogic();
-
-    return 0;
+    // fails when the exactly-once audit does
+    return programLogic() == 0 ? 0 : 1;
 }
\ No newline at end of file